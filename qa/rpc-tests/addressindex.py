@@ -212,6 +212,16 @@ class AddressIndexTest(BitcoinTestFramework):
         assert_equal(len(utxos2), 1)
         assert_equal(utxos2[0]["satoshis"], amount)
 
+        # Check that balances are not counted twice when blocks are connected
+        # again, after a restart and by verifychain
+        print "Testing balances after restart..."
+        stop_node(self.nodes[1], 1)
+        self.nodes[1] = start_node(1, self.options.tmpdir, ["-debug", "-addressindex", "-checklevel=4", "-checkblocks=20"])
+        connect_nodes(self.nodes[0], 1)
+        assert_equal(self.nodes[1].getaddressbalance(address2), balance1)
+        assert(self.nodes[1].verifychain(4, 20))
+        assert_equal(self.nodes[1].getaddressbalance(address2), balance1)
+
         # Check sorting of utxos
         self.nodes[2].generate(150)
 
@@ -227,6 +237,82 @@ class AddressIndexTest(BitcoinTestFramework):
         assert_equal(utxos3[1]["height"], 264)
         assert_equal(utxos3[2]["height"], 265)
 
+        # Check that balances follow the reorg onto the longer chain
+        balance5 = self.nodes[1].getaddressbalance(address2)
+        assert_equal(balance5["balance"], sum(utxo["satoshis"] for utxo in utxos3))
+
+        # Check that the history and utxos can be read page by page
+        print "Testing paging..."
+        addresses = ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB", "yMNJePdcKvXtWWQnFYHNeJ5u8TF2v1dfK4"]
+        sendmany_txid = self.nodes[0].sendmany("", {addresses[0]: 1, addresses[1]: 1})
+        self.nodes[0].generate(1)
+        self.sync_all()
+
+        # a transaction involving both addresses is listed once
+        alltxids = self.nodes[1].getaddresstxids({"addresses": addresses})
+        assert_equal(alltxids.count(sendmany_txid), 1)
+        query = {"addresses": addresses, "limit": 4}
+        page = self.nodes[1].getaddresstxids(query)
+        assert_equal(page["txids"], alltxids[:4])
+        pagedtxids = page["txids"]
+        while "cursor" in page:
+            query["cursor"] = page["cursor"]
+            page = self.nodes[1].getaddresstxids(query)
+            assert(0 < len(page["txids"]) <= 4)
+            pagedtxids += page["txids"]
+        assert_equal(pagedtxids, alltxids)
+        assert_equal(pagedtxids[-1], sendmany_txid)
+
+        # a transaction with several outputs to the address is not split between pages
+        txidsb = self.nodes[1].getaddresstxids("93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB")
+        query = {"addresses": [addresses[0]], "limit": 1}
+        pagedtxids = []
+        while True:
+            page = self.nodes[1].getaddresstxids(query)
+            assert_equal(len(page["txids"]), 1)
+            pagedtxids += page["txids"]
+            if "cursor" not in page:
+                break
+            query["cursor"] = page["cursor"]
+        assert_equal(pagedtxids, txidsb)
+
+        alldeltas = self.nodes[1].getaddressdeltas({"addresses": [address2]})
+        page = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 2})
+        assert_equal(page["deltas"], alldeltas[:2])
+        deltas_cursor = page["cursor"]
+        pageddeltas = page["deltas"]
+        while "cursor" in page:
+            page = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 2, "cursor": page["cursor"]})
+            pageddeltas += page["deltas"]
+        assert_equal(pageddeltas, alldeltas)
+
+        allutxos = self.nodes[1].getaddressutxos({"addresses": [address2]})
+        page = self.nodes[1].getaddressutxos({"addresses": [address2], "limit": 2})
+        assert_equal(len(page["utxos"]), 2)
+        pagedutxos = page["utxos"]
+        page = self.nodes[1].getaddressutxos({"addresses": [address2], "limit": 2, "cursor": page["cursor"]})
+        assert_equal(len(page["utxos"]), 1)
+        assert("cursor" not in page)
+        pagedutxos += page["utxos"]
+        outpoints = lambda utxos: sorted((utxo["txid"], utxo["outputIndex"]) for utxo in utxos)
+        assert_equal(outpoints(pagedutxos), outpoints(allutxos))
+
+        # malformed cursors, cursors of other addresses and cursors outside of the heights are rejected
+        txids_cursor = self.nodes[1].getaddresstxids({"addresses": addresses, "limit": 1})["cursor"]
+        cursor_height = alldeltas[2]["height"]
+        for method, query in [
+                (self.nodes[1].getaddressdeltas, {"addresses": [address2], "cursor": "zz"}),
+                (self.nodes[1].getaddressdeltas, {"addresses": [address2], "cursor": deltas_cursor[:10]}),
+                (self.nodes[1].getaddressdeltas, {"addresses": [address2], "cursor": txids_cursor}),
+                (self.nodes[1].getaddressdeltas, {"addresses": [address2], "cursor": deltas_cursor, "start": 1, "end": cursor_height - 1}),
+                (self.nodes[1].getaddresstxids, {"addresses": [address2], "cursor": deltas_cursor, "start": cursor_height + 1, "end": cursor_height + 10}),
+                (self.nodes[1].getaddressutxos, {"addresses": [address2], "cursor": "00"})]:
+            try:
+                method(query)
+                raise AssertionError("invalid cursor accepted: %s" % query)
+            except JSONRPCException as e:
+                assert_equal(e.error["code"], -8)
+
         # Check mempool indexing
         print "Testing mempool indexing..."
 
@@ -23,13 +23,16 @@ BenchRunner::BenchRunner(std::string name, BenchFunction func)
 }
 
 void
-BenchRunner::RunAll(double elapsedTimeForOne)
+BenchRunner::RunAll(double elapsedTimeForOne, const std::string& filter)
 {
     std::cout << "Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << "\n";
 
     for (std::map<std::string,BenchFunction>::iterator it = benchmarks.begin();
          it != benchmarks.end(); ++it) {
 
+        if (!filter.empty() && it->first.find(filter) == std::string::npos)
+            continue;
+
         State state(it->first, elapsedTimeForOne);
         BenchFunction& func = it->second;
         func(state);
@@ -68,3 +71,17 @@ bool State::KeepRunning()
 
     return false;
 }
+
+void State::PauseTiming()
+{
+    pauseTime = gettimedouble();
+}
+
+void State::ResumeTiming()
+{
+    // Shift the reference points forward so the paused interval is not
+    // attributed to the benchmark.
+    double paused = gettimedouble() - pauseTime;
+    beginTime += paused;
+    lastTime += paused;
+}
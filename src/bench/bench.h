@@ -41,15 +41,22 @@ namespace benchmark {
         double maxElapsed;
         double beginTime;
         double lastTime, minTime, maxTime;
+        double pauseTime;
         int64_t count;
         int64_t timeCheckCount;
     public:
-        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0) {
+        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), pauseTime(0), count(0) {
             minTime = std::numeric_limits<double>::max();
             maxTime = std::numeric_limits<double>::min();
             timeCheckCount = 1;
         }
         bool KeepRunning();
+
+        // Exclude per-iteration setup from the measurement. Every
+        // PauseTiming() must be matched by a ResumeTiming() before the next
+        // call to KeepRunning().
+        void PauseTiming();
+        void ResumeTiming();
     };
 
     typedef boost::function<void(State&)> BenchFunction;
@@ -61,7 +68,7 @@ namespace benchmark {
     public:
         BenchRunner(std::string name, BenchFunction func);
 
-        static void RunAll(double elapsedTimeForOne=1.0);
+        static void RunAll(double elapsedTimeForOne=1.0, const std::string& filter="");
     };
 }
 
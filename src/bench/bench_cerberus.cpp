@@ -14,8 +14,10 @@ main(int argc, char** argv)
     ECC_Start();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
+    ParseParameters(argc, argv);
 
-    benchmark::BenchRunner::RunAll();
+    // -filter=<substring> only runs the benchmarks whose name contains it
+    benchmark::BenchRunner::RunAll(1.0, GetArg("-filter", ""));
 
     ECC_Stop();
 }
@@ -0,0 +1,329 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "checkqueue.h"
+#include "coins.h"
+#include "consensus/consensus.h"
+#include "consensus/validation.h"
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "miner.h"
+#include "pow.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+// End-to-end block validation benchmarks over a synthetic regtest chain.
+//
+// The chain is built once, in memory, the first time one of the Chainstate*
+// benchmarks runs. Its shape can be changed with:
+//   -chainblocks=<n>  blocks with transactions on top of the first COINBASE_MATURITY (default: 20)
+//   -chaintxs=<n>     transactions per block (default: 100)
+//   -chaininputs=<n>  inputs per transaction (default: 2)
+//   -chainoutputs=<n> outputs per transaction (default: 3)
+// and the usual -dbcache, -par, -addressindex, -spentindex and -timestampindex
+// options apply, so their cost can be compared between runs, e.g.
+//   bench_cerberus -filter=Chainstate -addressindex -spentindex
+
+static const unsigned int CHAIN_KEYS = 16;
+static const CAmount CHAIN_TX_FEE = 10000;
+
+class ChainstateSetup
+{
+public:
+    ECCVerifyHandle globalVerifyHandle;
+    CCoinsViewDB *pcoinsdbview;
+    boost::filesystem::path pathTemp;
+    boost::thread_group threadGroup;
+    CCheckQueue<CScriptCheck> checkqueue;
+
+    CBlock tip;
+    CBlockIndex* pindexTip;
+
+    ChainstateSetup() : pcoinsdbview(NULL), checkqueue(128), pindexTip(NULL)
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        const CChainParams& chainparams = Params();
+
+        ClearDatadirCache();
+        pathTemp = GetTempPath() / strprintf("bench_cerberus_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+
+        // Same split of -dbcache as AppInit2
+        int64_t nTotalCache = (GetArg("-dbcache", nDefaultDbCache) << 20);
+        nTotalCache = std::max(nTotalCache, nMinDbCache << 20);
+        nTotalCache = std::min(nTotalCache, nMaxDbCache << 20);
+        int64_t nBlockTreeDBCache = nTotalCache / 8;
+        if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", DEFAULT_TXINDEX))
+            nBlockTreeDBCache = (1 << 21);
+        nTotalCache -= nBlockTreeDBCache;
+        int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23));
+        nTotalCache -= nCoinDBCache;
+        nCoinCacheUsage = nTotalCache;
+
+        pblocktree = new CBlockTreeDB(nBlockTreeDBCache, true);
+        pcoinsdbview = new CCoinsViewDB(nCoinDBCache, true);
+        pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+        InitBlockIndex(chainparams);
+
+        nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+        if (nScriptCheckThreads <= 0)
+            nScriptCheckThreads += GetNumCores();
+        if (nScriptCheckThreads <= 1)
+            nScriptCheckThreads = 0;
+        else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
+            nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+        for (int i = 0; i < nScriptCheckThreads - 1; i++) {
+            threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(boost::bind(&CCheckQueue<CScriptCheck>::Thread, &checkqueue));
+        }
+
+        BuildChain(chainparams);
+    }
+
+    ~ChainstateSetup()
+    {
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        UnloadBlockIndex();
+        delete pcoinsTip;
+        pcoinsTip = NULL;
+        delete pcoinsdbview;
+        pcoinsdbview = NULL;
+        delete pblocktree;
+        pblocktree = NULL;
+        boost::filesystem::remove_all(pathTemp);
+    }
+
+private:
+    struct Coin {
+        COutPoint outpoint;
+        CTxOut txout;
+        Coin(const COutPoint& outpointIn, const CTxOut& txoutIn) : outpoint(outpointIn), txout(txoutIn) {}
+    };
+
+    CBasicKeyStore keystore;
+    std::vector<CScript> vScripts;
+    std::deque<Coin> vCoins;
+
+    CBlock ProcessBlock(const CChainParams& chainparams, const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey)
+    {
+        // Space the blocks out so regtest keeps allowing min-difficulty
+        // blocks, otherwise the genesis target applies from height 2 on
+        SetMockTime(chainActive.Tip()->GetBlockTime() + chainparams.GetConsensus().nPowTargetSpacing * 2 + 1);
+
+        CBlockTemplate *pblocktemplate = CreateNewBlock(chainparams, scriptPubKey);
+        CBlock& block = pblocktemplate->block;
+
+        block.vtx.resize(1);
+        BOOST_FOREACH(const CMutableTransaction& tx, txns)
+            block.vtx.push_back(tx);
+        unsigned int extraNonce = 0;
+        IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
+
+        CValidationState state;
+        if (!ProcessNewBlock(state, chainparams, NULL, &block, true, NULL) || chainActive.Tip()->GetBlockHash() != block.GetHash())
+            throw std::runtime_error(strprintf("%s: block rejected: %s", __func__, FormatStateMessage(state)));
+
+        CBlock result = block;
+        delete pblocktemplate;
+        return result;
+    }
+
+    // Spend the oldest coins from the pool, the new outputs go to the back
+    // so later transactions in the same block can chain off them.
+    CMutableTransaction CreateSpend(unsigned int nInputs, unsigned int nOutputs)
+    {
+        CMutableTransaction tx;
+        std::vector<CScript> vPrevScripts;
+        CAmount nValueIn = 0;
+        while (tx.vin.size() < nInputs && !vCoins.empty()) {
+            tx.vin.push_back(CTxIn(vCoins.front().outpoint));
+            vPrevScripts.push_back(vCoins.front().txout.scriptPubKey);
+            nValueIn += vCoins.front().txout.nValue;
+            vCoins.pop_front();
+        }
+        CAmount nValueOut = nValueIn - CHAIN_TX_FEE;
+        if (tx.vin.empty() || nValueOut < (CAmount)nOutputs * CHAIN_TX_FEE)
+            throw std::runtime_error(strprintf("%s: ran out of spendable coins", __func__));
+        for (unsigned int i = 0; i < nOutputs; i++) {
+            CAmount nValue = nValueOut / nOutputs + (i == 0 ? nValueOut % nOutputs : 0);
+            tx.vout.push_back(CTxOut(nValue, vScripts[GetRand(vScripts.size())]));
+        }
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            if (!SignSignature(keystore, vPrevScripts[i], tx, i))
+                throw std::runtime_error(strprintf("%s: signing failed", __func__));
+        }
+        const uint256 txid = tx.GetHash();
+        for (unsigned int i = 0; i < tx.vout.size(); i++)
+            vCoins.push_back(Coin(COutPoint(txid, i), tx.vout[i]));
+        return tx;
+    }
+
+    void BuildChain(const CChainParams& chainparams)
+    {
+        for (unsigned int i = 0; i < CHAIN_KEYS; i++) {
+            CKey key;
+            key.MakeNewKey(true);
+            keystore.AddKey(key);
+            vScripts.push_back(GetScriptForDestination(key.GetPubKey().GetID()));
+        }
+
+        const int nBlocks = GetArg("-chainblocks", 20);
+        const int nTxs = GetArg("-chaintxs", 100);
+        const int nInputs = std::max(1, (int)GetArg("-chaininputs", 2));
+        const int nOutputs = std::max(1, (int)GetArg("-chainoutputs", 3));
+
+        // Coinbases become spendable COINBASE_MATURITY blocks later
+        std::vector<CTransaction> vCoinbases;
+        for (int nHeight = 1; nHeight <= COINBASE_MATURITY + nBlocks; nHeight++) {
+            std::vector<CMutableTransaction> txns;
+            if (nHeight > COINBASE_MATURITY) {
+                const CTransaction& coinbase = vCoinbases[nHeight - COINBASE_MATURITY - 1];
+                vCoins.push_back(Coin(COutPoint(coinbase.GetHash(), 0), coinbase.vout[0]));
+                for (int i = 0; i < nTxs; i++)
+                    txns.push_back(CreateSpend(nInputs, nOutputs));
+            }
+            tip = ProcessBlock(chainparams, txns, vScripts[nHeight % vScripts.size()]);
+            vCoinbases.push_back(tip.vtx[0]);
+        }
+        pindexTip = chainActive.Tip();
+        SetMockTime(0);
+        FlushStateToDisk();
+    }
+};
+
+static ChainstateSetup& GetChainstateSetup()
+{
+    static ChainstateSetup setup;
+    return setup;
+}
+
+// Disconnect the tip into a throwaway view on top of the coins cache. With
+// pfClean set DisconnectBlock only touches the view, the address indexes and
+// the coinbase payees keep the tip.
+static void DisconnectTipIntoView(ChainstateSetup& setup, CCoinsViewCache& view)
+{
+    CValidationState state;
+    bool fClean;
+    if (!DisconnectBlock(setup.tip, state, setup.pindexTip, view, &fClean) || !fClean)
+        throw std::runtime_error("DisconnectBlock failed");
+}
+
+static void ChainstateConnectBlock(benchmark::State& state)
+{
+    ChainstateSetup& setup = GetChainstateSetup();
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        CCoinsViewCache viewPrev(pcoinsTip);
+        DisconnectTipIntoView(setup, viewPrev);
+        state.ResumeTiming();
+
+        // The tip already has undo data, so only the index writes hit disk
+        CCoinsViewCache view(&viewPrev);
+        CValidationState valstate;
+        if (!ConnectBlock(setup.tip, valstate, setup.pindexTip, view))
+            throw std::runtime_error("ConnectBlock failed");
+    }
+}
+
+static void ChainstateCheckInputs(benchmark::State& state)
+{
+    ChainstateSetup& setup = GetChainstateSetup();
+    LOCK(cs_main);
+    const unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG | SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        CCoinsViewCache view(pcoinsTip);
+        DisconnectTipIntoView(setup, view);
+        state.ResumeTiming();
+
+        // Mirrors the script verification part of ConnectBlock, with the
+        // checks handed to a queue served by -par threads
+        CCheckQueueControl<CScriptCheck> control(nScriptCheckThreads ? &setup.checkqueue : NULL);
+        for (unsigned int i = 1; i < setup.tip.vtx.size(); i++) {
+            const CTransaction& tx = setup.tip.vtx[i];
+            CValidationState valstate;
+            std::vector<CScriptCheck> vChecks;
+            if (!CheckInputs(tx, valstate, view, true, flags, false, nScriptCheckThreads ? &vChecks : NULL))
+                throw std::runtime_error("CheckInputs failed");
+            control.Add(vChecks);
+            UpdateCoins(tx, valstate, view, setup.pindexTip->nHeight);
+        }
+        if (!control.Wait())
+            throw std::runtime_error("script verification failed");
+    }
+}
+
+static void ChainstateDisconnectBlock(benchmark::State& state)
+{
+    ChainstateSetup& setup = GetChainstateSetup();
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(pcoinsTip);
+        DisconnectTipIntoView(setup, view);
+    }
+}
+
+static void ChainstateFlushStateToDisk(benchmark::State& state)
+{
+    ChainstateSetup& setup = GetChainstateSetup();
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        // Rewrite the tip's coins so the cache has the block's worth of
+        // dirty entries to write out
+        state.PauseTiming();
+        {
+            CCoinsViewCache view(pcoinsTip);
+            DisconnectTipIntoView(setup, view);
+            CValidationState valstate;
+            if (!ConnectBlock(setup.tip, valstate, setup.pindexTip, view))
+                throw std::runtime_error("ConnectBlock failed");
+            view.Flush();
+        }
+        state.ResumeTiming();
+
+        FlushStateToDisk();
+    }
+}
+
+static void ChainstateActivateBestChain(benchmark::State& state)
+{
+    ChainstateSetup& setup = GetChainstateSetup();
+    const CChainParams& chainparams = Params();
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        if (!DisconnectBlocks(1))
+            throw std::runtime_error("DisconnectBlocks failed");
+        state.ResumeTiming();
+
+        // Reads the tip back from disk and connects it
+        CValidationState valstate;
+        if (!ActivateBestChain(valstate, chainparams) || chainActive.Tip() != setup.pindexTip)
+            throw std::runtime_error("ActivateBestChain failed");
+    }
+}
+
+BENCHMARK(ChainstateConnectBlock);
+BENCHMARK(ChainstateCheckInputs);
+BENCHMARK(ChainstateDisconnectBlock);
+BENCHMARK(ChainstateFlushStateToDisk);
+BENCHMARK(ChainstateActivateBestChain);
@@ -0,0 +1,128 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "crypto/neoscrypt.h"
+#include "pow.h"
+#include "primitives/block.h"
+
+#include <string.h>
+#include <vector>
+
+// Neoscrypt proof-of-work microbenchmarks. Whether the scalar C or the
+// assembly implementation is measured depends on how libbitcoin_crypto was
+// built (see --enable-neoscrypt-asm).
+
+static CBlockHeader MakeBenchHeader()
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.hashPrevBlock = uint256S("0x00000000000abcdef0123456789abcdef0123456789abcdef0123456789abcd");
+    header.hashMerkleRoot = uint256S("0x0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef");
+    header.nTime = 1500000000;
+    header.nBits = 0x1e0fffff;
+    header.nNonce = 0;
+    return header;
+}
+
+static void NeoScrypt(benchmark::State& state)
+{
+    CBlockHeader header = MakeBenchHeader();
+    unsigned char output[32];
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        neoscrypt((const unsigned char*)&header.nVersion, output, 0);
+    }
+}
+
+// Hashes as many headers per call as neoscrypt_batch can process in one
+// SIMD pass; the per-iteration time is for the whole group.
+static void NeoScryptBatch(benchmark::State& state)
+{
+    const unsigned int nLanes = neoscrypt_batch_lanes();
+    std::vector<unsigned char> input(nLanes * CBlockHeader::HEADER_SIZE);
+    std::vector<unsigned char> output(nLanes * 32);
+    CBlockHeader header = MakeBenchHeader();
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < nLanes; i++) {
+            header.nNonce++;
+            memcpy(&input[i * CBlockHeader::HEADER_SIZE], &header.nVersion, CBlockHeader::HEADER_SIZE);
+        }
+        neoscrypt_batch(&input[0], &output[0], nLanes);
+    }
+}
+
+static void NeoScryptBlake2s(benchmark::State& state)
+{
+    unsigned char input[64], key[32], output[32];
+    memset(input, 0x5a, sizeof(input));
+    memset(key, 0xa5, sizeof(key));
+    while (state.KeepRunning()) {
+        neoscrypt_blake2s(input, sizeof(input), key, sizeof(key), output, sizeof(output));
+        input[0]++;
+    }
+}
+
+static void BlockHeaderGetHash(benchmark::State& state)
+{
+    CBlockHeader header = MakeBenchHeader();
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetHash();
+    }
+}
+
+static void BlockHeaderGetHashCached(benchmark::State& state)
+{
+    CBlockHeader header = MakeBenchHeader();
+    header.GetHash();
+    while (state.KeepRunning()) {
+        header.GetHash();
+    }
+}
+
+static void CheckProofOfWorkBench(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    const unsigned int nBits = UintToArith256(params.powLimit).GetCompact();
+    uint256 hash = uint256S("0x0000000000ffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    while (state.KeepRunning()) {
+        CheckProofOfWork(hash, nBits, params);
+        *hash.begin() += 1;
+    }
+}
+
+// Retargeting at the tip of a synthetic mainnet chain past the DGW
+// activation height.
+static void GetNextWorkRequiredDGW(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+    const unsigned int nBits = UintToArith256(params.powLimit).GetCompact();
+
+    std::vector<CBlockIndex> blocks(2000);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : NULL;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = 1500000000 + i * params.nPowTargetSpacing + (i % 7) * 13;
+        blocks[i].nBits = nBits - (i % 5);
+    }
+    CBlockHeader header = MakeBenchHeader();
+    header.nTime = blocks.back().nTime + params.nPowTargetSpacing;
+    while (state.KeepRunning()) {
+        GetNextWorkRequired(&blocks.back(), &header, params);
+    }
+}
+
+BENCHMARK(NeoScrypt);
+BENCHMARK(NeoScryptBatch);
+BENCHMARK(NeoScryptBlake2s);
+BENCHMARK(BlockHeaderGetHash);
+BENCHMARK(BlockHeaderGetHashCached);
+BENCHMARK(CheckProofOfWorkBench);
+BENCHMARK(GetNextWorkRequiredDGW);
@@ -43,6 +43,7 @@
 #include <ifaddrs.h>
 #include <limits.h>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
 #endif
 
@@ -93,8 +94,17 @@ typedef u_int SOCKET;
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
+// Sockets are waited on with poll (or epoll) instead of select, so they
+// are not limited to FD_SETSIZE
+#ifndef WIN32
+#define USE_POLL
+#ifdef __linux__
+#define USE_EPOLL
+#endif
+#endif
+
 bool static inline IsSelectableSocket(SOCKET s) {
-#ifdef WIN32
+#if defined(WIN32) || defined(USE_POLL)
     return true;
 #else
     return (s < FD_SETSIZE);
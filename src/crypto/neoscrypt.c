@@ -2834,11 +2834,12 @@ static void neoscrypt_xor_4way(void *dstp, const void *srcAp,
 #endif
 
 
-/* 4-way NeoScrypt(128, 2, 1) with Salsa20/20 and ChaCha20/20 */
-void neoscrypt_4way(const uchar *password, uchar *output, uchar *scratchpad) {
+/* 4-way NeoScrypt(128, 2, 1) with Salsa20/20 and ChaCha20/20;
+ * expects the 4 passwords to be loaded into the scratchpad already */
+static void neoscrypt_4way_core(uchar *output, uchar *scratchpad) {
     const uint N = 128, r = 2, double_rounds = 10;
     uint *X, *Z, *V, *Y, *P;
-    uint i, j0, j1, j2, j3, k;
+    uint i, j0, j1, j2, j3;
 
     /* 2 * BLOCK_SIZE compacted to 128 below */;
 
@@ -2852,12 +2853,6 @@ void neoscrypt_4way(const uchar *password, uchar *output, uchar *scratchpad) {
     /* P is a set of passwords 80 bytes each */
     P = &X[4 * (N + 3) * 32 * r];
 
-    /* Load the password and increment nonces */
-    for(k = 0; k < 4; k++) {
-        neoscrypt_copy(&P[k * 20], password, 80);
-        P[(k + 1) * 20 - 1] += k;
-    }
-
     neoscrypt_fastkdf_4way((uchar *) &P[0], (uchar *) &P[0], (uchar *) &Y[0],
       (uchar *) &scratchpad[0], 0);
 
@@ -2919,6 +2914,34 @@ void neoscrypt_4way(const uchar *password, uchar *output, uchar *scratchpad) {
       (uchar *) &scratchpad[0], 1);
 }
 
+/* Offset of the password set within the 4-way scratchpad */
+#define NEOSCRYPT_4WAY_P_OFFSET (4 * (128 + 3) * 32 * 2 * sizeof(uint))
+
+/* 4-way NeoScrypt(128, 2, 1) of a single password with nonces incremented
+ * by 0 to 3 as used by miners */
+void neoscrypt_4way(const uchar *password, uchar *output, uchar *scratchpad) {
+    uint *P = (uint *) &scratchpad[NEOSCRYPT_4WAY_P_OFFSET];
+    uint k;
+
+    /* Load the password and increment nonces */
+    for(k = 0; k < 4; k++) {
+        neoscrypt_copy(&P[k * 20], password, 80);
+        P[(k + 1) * 20 - 1] += k;
+    }
+
+    neoscrypt_4way_core(output, scratchpad);
+}
+
+/* 4-way NeoScrypt(128, 2, 1) of 4 independent 80 byte passwords stored
+ * back to back, e.g. a batch of block headers; outputs are 32 bytes each */
+void neoscrypt_4way_multi(const uchar *passwords, uchar *output, uchar *scratchpad) {
+    uint *P = (uint *) &scratchpad[NEOSCRYPT_4WAY_P_OFFSET];
+
+    neoscrypt_copy(&P[0], passwords, 4 * 80);
+
+    neoscrypt_4way_core(output, scratchpad);
+}
+
 #ifdef SHA256
 /* 4-way Scrypt(1024, 1, 1) with Salsa20/8 */
 void scrypt_4way(const uchar *password, uchar *output, uchar *scratchpad) {
@@ -3261,3 +3284,41 @@ uint cpu_vec_exts() {
     return(0);
 }
 #endif
+
+
+/* Number of NeoScrypt(128, 2, 1) lanes computed at once by neoscrypt_batch() */
+uint neoscrypt_batch_lanes() {
+
+#if defined(ASM) && defined(MINER_4WAY)
+    /* SSE2 (bit 5) */
+    if(cpu_vec_exts() & 0x20)
+      return(4);
+#endif
+
+    return(1);
+}
+
+/* NeoScrypt(128, 2, 1) of count independent 80 byte passwords stored
+ * back to back into count 32 byte outputs; groups of 4 are processed
+ * in parallel SIMD lanes if supported, the rest one by one */
+void neoscrypt_batch(const uchar *passwords, uchar *output, uint count) {
+    uint i = 0;
+
+#if defined(ASM) && defined(MINER_4WAY)
+    if((count >= 4) && (neoscrypt_batch_lanes() == 4)) {
+        const size_t stack_align = 0x40;
+        /* Scratchpad size is 4 * ((N + 3) * r * 128 + 80) bytes */
+        uchar *mem = (uchar *) malloc(4 * ((128 + 3) * 2 * 128 + 80) + stack_align);
+
+        if(mem) {
+            uchar *scratchpad = (uchar *) (((size_t)mem & ~(stack_align - 1)) + stack_align);
+            for(; i + 4 <= count; i += 4)
+              neoscrypt_4way_multi(&passwords[i * 80], &output[i * 32], scratchpad);
+            free(mem);
+        }
+    }
+#endif
+
+    for(; i < count; i++)
+      neoscrypt(&passwords[i * 80], &output[i * 32], 0x0);
+}
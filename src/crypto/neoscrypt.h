@@ -17,6 +17,9 @@ void neoscrypt_xor(void *dstp, const void *srcp, unsigned int len);
 void neoscrypt_4way(const unsigned char *password, unsigned char *output,
   unsigned char *scratchpad);
 
+void neoscrypt_4way_multi(const unsigned char *passwords, unsigned char *output,
+  unsigned char *scratchpad);
+
 #ifdef SHA256
 void scrypt_4way(const unsigned char *password, unsigned char *output,
   unsigned char *scratchpad);
@@ -32,6 +35,11 @@ void neoscrypt_fastkdf_4way(const unsigned char *password,
 
 unsigned int cpu_vec_exts(void);
 
+unsigned int neoscrypt_batch_lanes(void);
+
+void neoscrypt_batch(const unsigned char *passwords, unsigned char *output,
+  unsigned int count);
+
 #if (__cplusplus)
 }
 #else
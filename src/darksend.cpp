@@ -13,7 +13,10 @@
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
+#include "memusage.h"
+#include "random.h"
 #include "script/sign.h"
+#include "sigcheckqueue.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -2295,25 +2298,116 @@ bool CDarkSendSigner::SignMessage(std::string strMessage, std::vector<unsigned c
     return key.SignCompact(ss.GetHash(), vchSigRet);
 }
 
-bool CDarkSendSigner::VerifyMessage(CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string strMessage, std::string& strErrorRet)
+CMessageSignatureCache::CMessageSignatureCache()
+    : nHits(0),
+      nMisses(0)
+{
+    GetRandBytes(nonce.begin(), 32);
+}
+
+uint256 CMessageSignatureCache::ComputeEntry(const uint256& hashMessage, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig) const
+{
+    uint256 entry;
+    CSHA256 hasher;
+    hasher.Write(nonce.begin(), 32).Write(hashMessage.begin(), 32);
+    if(pubkey.size()) hasher.Write(pubkey.begin(), pubkey.size());
+    if(!vchSig.empty()) hasher.Write(&vchSig[0], vchSig.size());
+    hasher.Finalize(entry.begin());
+    return entry;
+}
+
+bool CMessageSignatureCache::Get(const uint256& entry)
+{
+    LOCK(cs);
+    if(setValid.count(entry)) {
+        nHits++;
+        return true;
+    }
+    nMisses++;
+    return false;
+}
+
+void CMessageSignatureCache::Set(const uint256& entry)
+{
+    size_t nMaxCacheSize = GetArg("-maxmnsigcachesize", DEFAULT_MAX_MN_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    if(nMaxCacheSize <= 0) return;
+
+    LOCK(cs);
+    // evict random entries, the nonce keeps peers from predicting which
+    while(memusage::DynamicUsage(setValid) > nMaxCacheSize) {
+        set_t::size_type s = GetRand(setValid.bucket_count());
+        set_t::local_iterator it = setValid.begin(s);
+        if(it != setValid.end(s)) {
+            setValid.erase(*it);
+        }
+    }
+
+    setValid.insert(entry);
+}
+
+size_t CMessageSignatureCache::size() const
+{
+    LOCK(cs);
+    return setValid.size();
+}
+
+size_t CMessageSignatureCache::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return memusage::DynamicUsage(setValid);
+}
+
+uint64_t CMessageSignatureCache::GetHits() const
+{
+    LOCK(cs);
+    return nHits;
+}
+
+uint64_t CMessageSignatureCache::GetMisses() const
+{
+    LOCK(cs);
+    return nMisses;
+}
+
+uint256 CDarkSendSigner::GetMessageHash(const std::string& strMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
+    return ss.GetHash();
+}
+
+bool CDarkSendSigner::VerifyMessage(CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string strMessage, std::string& strErrorRet)
+{
+    uint256 hashMessage = GetMessageHash(strMessage);
+
+    uint256 entry = signatureCache.ComputeEntry(hashMessage, pubkey, vchSig);
+    if(signatureCache.Get(entry)) {
+        return true;
+    }
+
+    // the key may have been recovered on a worker thread already
+    bool fRecovered = false;
+    CKeyID keyIDFromSig;
+    if(!sigcheckqueue.GetResult(hashMessage, vchSig, fRecovered, keyIDFromSig)) {
+        CPubKey pubkeyFromSig;
+        fRecovered = pubkeyFromSig.RecoverCompact(hashMessage, vchSig);
+        keyIDFromSig = pubkeyFromSig.GetID();
+    }
 
-    CPubKey pubkeyFromSig;
-    if(!pubkeyFromSig.RecoverCompact(ss.GetHash(), vchSig)) {
+    if(!fRecovered) {
         strErrorRet = "Error recovering public key.";
         return false;
     }
 
-    if(pubkeyFromSig.GetID() != pubkey.GetID()) {
+    if(keyIDFromSig != pubkey.GetID()) {
         strErrorRet = strprintf("Keys don't match: pubkey=%s, pubkeyFromSig=%s, strMessage=%s, vchSig=%s",
-                    pubkey.GetID().ToString(), pubkeyFromSig.GetID().ToString(), strMessage,
+                    pubkey.GetID().ToString(), keyIDFromSig.ToString(), strMessage,
                     EncodeBase64(&vchSig[0], vchSig.size()));
         return false;
     }
 
+    signatureCache.Set(entry);
     return true;
 }
 
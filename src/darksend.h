@@ -9,6 +9,8 @@
 #include "masternode.h"
 #include "wallet/wallet.h"
 
+#include <boost/unordered_set.hpp>
+
 class CDarksendPool;
 class CDarkSendSigner;
 class CDarksendBroadcastTx;
@@ -31,6 +33,9 @@ static const int DEFAULT_PRIVATESEND_AMOUNT         = 1000;
 static const int DEFAULT_PRIVATESEND_LIQUIDITY      = 0;
 static const bool DEFAULT_PRIVATESEND_MULTISESSION  = false;
 
+//! limit the cache of valid masternode message signatures to this many MiB
+static const unsigned int DEFAULT_MAX_MN_SIG_CACHE_SIZE = 8;
+
 // Warn user if mixing in gui or try to create backup if mixing in daemon mode
 // when we have only this many keys left
 static const int PRIVATESEND_KEYS_THRESHOLD_WARNING = 100;
@@ -235,6 +240,42 @@ public:
     bool CheckSignature(const CPubKey& pubKeyMasternode);
 };
 
+class CMessageSignatureCacheHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/** Valid signatures of masternode messages, so that pings and votes which
+ *  arrive from many peers or are re-checked later are only verified once
+ */
+class CMessageSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || message hash || public key || signature)
+    uint256 nonce;
+    typedef boost::unordered_set<uint256, CMessageSignatureCacheHasher> set_t;
+    set_t setValid;
+    uint64_t nHits;
+    uint64_t nMisses;
+    mutable CCriticalSection cs;
+
+public:
+    CMessageSignatureCache();
+
+    uint256 ComputeEntry(const uint256& hashMessage, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig) const;
+    /// Look the entry up and count it as a hit or a miss
+    bool Get(const uint256& entry);
+    void Set(const uint256& entry);
+
+    size_t size() const;
+    size_t DynamicMemoryUsage() const;
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+};
+
 /** Helper object for signing and checking signatures
  */
 class CDarkSendSigner
@@ -246,8 +287,13 @@ public:
     bool GetKeysFromSecret(std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet);
     /// Sign the message, returns true if successful
     bool SignMessage(std::string strMessage, std::vector<unsigned char>& vchSigRet, CKey key);
+    /// Hash which is signed for the message
+    static uint256 GetMessageHash(const std::string& strMessage);
     /// Verify the message, returns true if succcessful
     bool VerifyMessage(CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string strMessage, std::string& strErrorRet);
+
+    /// Signatures accepted by VerifyMessage
+    CMessageSignatureCache signatureCache;
 };
 
 /** Used to keep track of current status of mixing pool
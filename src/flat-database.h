@@ -38,6 +38,13 @@ private:
     std::string strFilename;
     std::string strMagicMessage;
 
+    /**
+     * The object is serialized into memory first, which holds its locks only
+     * for as long as serializing takes. Writing and syncing the file happens
+     * without them. The file only replaces the existing one once it is
+     * complete and synced, a crash in the middle of a dump leaves the
+     * previous version intact.
+     */
     bool Write(const T& objToSave)
     {
         // LOCK(objToSave.cs);
@@ -46,84 +53,51 @@ private:
 
         // serialize, checksum data up to that point, then append checksum
         CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-        ssObj << strMagicMessage; // specific magic message for this type of object
-        ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-        ssObj << objToSave;
+        try {
+            ssObj << strMagicMessage; // specific magic message for this type of object
+            ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
+            ssObj << objToSave;
+        }
+        catch (std::exception &e) {
+            return error("%s: Serialize error - %s", __func__, e.what());
+        }
         uint256 hash = Hash(ssObj.begin(), ssObj.end());
         ssObj << hash;
 
+        boost::filesystem::path pathTmp = pathDB.string() + ".new";
+
         // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-        // Write and commit header, data
+        // write data and checksum
         try {
-            fileout << ssObj;
+            fileout.write(&ssObj[0], ssObj.size());
         }
         catch (std::exception &e) {
-            return error("%s: Serialize or I/O error - %s", __func__, e.what());
+            return error("%s: I/O error - %s", __func__, e.what());
         }
+        FileCommit(fileout.Get());
         fileout.fclose();
 
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Rename-into-place failed", __func__);
+
         LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
 
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    ReadResult ReadHeader(CHashVerifier<CAutoFile>& verifier)
     {
-        //LOCK(objToLoad.cs);
-
-        int64_t nStart = GetTimeMillis();
-        // open input file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "rb");
-        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-        if (filein.IsNull())
-        {
-            error("%s: Failed to open file %s", __func__, pathDB.string());
-            return FileError;
-        }
-
-        // use file size to size memory buffer
-        int fileSize = boost::filesystem::file_size(pathDB);
-        int dataSize = fileSize - sizeof(uint256);
-        // Don't try to resize to a negative number if file is small
-        if (dataSize < 0)
-            dataSize = 0;
-        std::vector<unsigned char> vchData;
-        vchData.resize(dataSize);
-        uint256 hashIn;
-
-        // read data and checksum from file
-        try {
-            filein.read((char *)&vchData[0], dataSize);
-            filein >> hashIn;
-        }
-        catch (std::exception &e) {
-            error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            return HashReadError;
-        }
-        filein.fclose();
-
-        CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-        // verify stored checksum matches input data
-        uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-        if (hashIn != hashTmp)
-        {
-            error("%s: Checksum mismatch, data corrupted", __func__);
-            return IncorrectHash;
-        }
-
-
         unsigned char pchMsgTmp[4];
         std::string strMagicMessageTmp;
         try {
             // de-serialize file header (file specific magic message) and ..
-            ssObj >> strMagicMessageTmp;
+            verifier >> strMagicMessageTmp;
 
             // ... verify the message matches predefined one
             if (strMagicMessage != strMagicMessageTmp)
@@ -132,9 +106,8 @@ private:
                 return IncorrectMagicMessage;
             }
 
-
             // de-serialize file header (network specific magic number) and ..
-            ssObj >> FLATDATA(pchMsgTmp);
+            verifier >> FLATDATA(pchMsgTmp);
 
             // ... verify the network matches ours
             if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
@@ -142,9 +115,52 @@ private:
                 error("%s: Invalid network magic number", __func__);
                 return IncorrectMagicNumber;
             }
+        }
+        catch (std::exception &e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return IncorrectFormat;
+        }
+        return Ok;
+    }
 
+    /** Only check the header of an existing file, the data is overwritten anyway */
+    ReadResult ReadHeaderOnly()
+    {
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+        {
+            error("%s: Failed to open file %s", __func__, pathDB.string());
+            return FileError;
+        }
+
+        CHashVerifier<CAutoFile> verifier(&filein);
+        return ReadHeader(verifier);
+    }
+
+    ReadResult Read(T& objToLoad)
+    {
+        //LOCK(objToLoad.cs);
+
+        int64_t nStart = GetTimeMillis();
+        // open input file, and associate with CAutoFile
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+        {
+            error("%s: Failed to open file %s", __func__, pathDB.string());
+            return FileError;
+        }
+
+        // read and hash the data straight from the file
+        CHashVerifier<CAutoFile> verifier(&filein);
+        ReadResult headerResult = ReadHeader(verifier);
+        if (headerResult != Ok)
+            return headerResult;
+
+        try {
             // de-serialize data into T object
-            ssObj >> objToLoad;
+            verifier >> objToLoad;
         }
         catch (std::exception &e) {
             objToLoad.Clear();
@@ -152,13 +168,30 @@ private:
             return IncorrectFormat;
         }
 
+        // verify stored checksum matches input data
+        uint256 hashIn;
+        try {
+            filein >> hashIn;
+        }
+        catch (std::exception &e) {
+            objToLoad.Clear();
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return HashReadError;
+        }
+        filein.fclose();
+
+        if (hashIn != verifier.GetHash())
+        {
+            objToLoad.Clear();
+            error("%s: Checksum mismatch, data corrupted", __func__);
+            return IncorrectHash;
+        }
+
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
-        if(!fDryRun) {
-            LogPrintf("%s: Cleaning....\n", __func__);
-            objToLoad.CheckAndRemove();
-            LogPrintf("     %s\n", objToLoad.ToString());
-        }
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
 
         return Ok;
     }
@@ -199,8 +232,7 @@ public:
         int64_t nStart = GetTimeMillis();
 
         LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
+        ReadResult readResult = ReadHeaderOnly();
 
         // there was an error and it was not an error on file opening => do not proceed
         if (readResult == FileError)
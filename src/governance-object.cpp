@@ -190,7 +190,8 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     }
     voteInstance = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     if(!fileVotes.HasVote(vote.GetHash())) {
-        fileVotes.AddVote(vote);
+        // signature and masternode were checked above, Sync doesn't have to redo it
+        fileVotes.AddVote(vote, true);
     }
     fDirtyCache = true;
     return true;
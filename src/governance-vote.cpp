@@ -230,6 +230,12 @@ void CGovernanceVote::Relay() const
     RelayInv(inv, PROTOCOL_VERSION);
 }
 
+std::string CGovernanceVote::GetSignatureMessage() const
+{
+    return vinMasternode.prevout.ToStringShort() + "|" + nParentHash.ToString() + "|" +
+        boost::lexical_cast<std::string>(nVoteSignal) + "|" + boost::lexical_cast<std::string>(nVoteOutcome) + "|" + boost::lexical_cast<std::string>(nTime);
+}
+
 bool CGovernanceVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
 {
     // Choose coins to use
@@ -237,8 +243,7 @@ bool CGovernanceVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     CKey keyCollateralAddress;
 
     std::string strError;
-    std::string strMessage = vinMasternode.prevout.ToStringShort() + "|" + nParentHash.ToString() + "|" +
-        boost::lexical_cast<std::string>(nVoteSignal) + "|" + boost::lexical_cast<std::string>(nVoteOutcome) + "|" + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     if(!darkSendSigner.SignMessage(strMessage, vchSig, keyMasternode)) {
         LogPrintf("CGovernanceVote::Sign -- SignMessage() failed\n");
@@ -283,8 +288,7 @@ bool CGovernanceVote::IsValid(bool fSignatureCheck) const
     if(!fSignatureCheck) return true;
 
     std::string strError;
-    std::string strMessage = vinMasternode.prevout.ToStringShort() + "|" + nParentHash.ToString() + "|" +
-        boost::lexical_cast<std::string>(nVoteSignal) + "|" + boost::lexical_cast<std::string>(nVoteOutcome) + "|" + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     if(!darkSendSigner.VerifyMessage(infoMn.pubKeyMasternode, vchSig, strMessage, strError)) {
         LogPrintf("CGovernanceVote::IsValid -- VerifyMessage() failed, error: %s\n", strError);
@@ -121,6 +121,9 @@ public:
 
     void SetSignature(const std::vector<unsigned char>& vchSigIn) { vchSig = vchSigIn; }
 
+    const std::vector<unsigned char>& GetSignature() const { return vchSig; }
+
+    std::string GetSignatureMessage() const;
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool IsValid(bool fSignatureCheck) const;
     void Relay() const;
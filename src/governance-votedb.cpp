@@ -4,79 +4,421 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "governance-votedb.h"
+#include "util.h"
+
+#include <boost/scoped_ptr.hpp>
+
+static const char DB_GOVERNANCE_VOTE = 'v';
+static const char DB_GOVERNANCE_MASTERNODE_VOTE = 'm';
+
+CGovernanceVoteDB* pgovernancevotedb = NULL;
+
+CGovernanceVoteDB::CGovernanceVoteDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CDBWrapper(GetDataDir() / "governancevotes", nCacheSize, fMemory, fWipe)
+{}
+
+bool CGovernanceVoteDB::WriteVote(const CGovernanceVote& vote)
+{
+    const uint256 nParentHash = vote.GetParentHash();
+    const uint256 nHash = vote.GetHash();
+    CDBBatch batch(&GetObfuscateKey());
+    batch.Write(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nHash)), vote);
+    batch.Write(std::make_pair(DB_GOVERNANCE_MASTERNODE_VOTE, std::make_pair(nParentHash, std::make_pair(vote.GetVinMasternode().prevout, nHash))), '\0');
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::ReadVote(const uint256& nParentHash, const uint256& nHash, CGovernanceVote& vote) const
+{
+    return Read(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nHash)), vote);
+}
+
+bool CGovernanceVoteDB::HasVote(const uint256& nParentHash, const uint256& nHash) const
+{
+    return Exists(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nHash)));
+}
+
+bool CGovernanceVoteDB::EraseVote(const CGovernanceVote& vote)
+{
+    const uint256 nParentHash = vote.GetParentHash();
+    const uint256 nHash = vote.GetHash();
+    CDBBatch batch(&GetObfuscateKey());
+    batch.Erase(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nHash)));
+    batch.Erase(std::make_pair(DB_GOVERNANCE_MASTERNODE_VOTE, std::make_pair(nParentHash, std::make_pair(vote.GetVinMasternode().prevout, nHash))));
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotes)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, uint256())));
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if (!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_VOTE || key.second.first != nParentHash) {
+            break;
+        }
+        CGovernanceVote vote;
+        if (!pcursor->GetValue(vote)) {
+            return error("%s: failed to read vote %s", __func__, key.second.second.ToString());
+        }
+        vecVotes.push_back(vote);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CGovernanceVoteDB::ReadVoteHashes(const uint256& nParentHash, std::vector<uint256>& vecHashes)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, uint256())));
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if (!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_VOTE || key.second.first != nParentHash) {
+            break;
+        }
+        vecHashes.push_back(key.second.second);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CGovernanceVoteDB::ReadMasternodeVoteHashes(const uint256& nParentHash, const COutPoint& outpointMasternode, std::vector<uint256>& vecHashes)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_GOVERNANCE_MASTERNODE_VOTE, std::make_pair(nParentHash, std::make_pair(outpointMasternode, uint256()))));
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, std::pair<COutPoint, uint256> > > key;
+        if (!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_MASTERNODE_VOTE || key.second.first != nParentHash ||
+                key.second.second.first != outpointMasternode) {
+            break;
+        }
+        vecHashes.push_back(key.second.second.second);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CGovernanceVoteDB::ReadVoteKeys(std::vector<std::pair<uint256, uint256> >& vecKeys)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(DB_GOVERNANCE_VOTE);
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if (!pcursor->GetKey(key) || key.first != DB_GOVERNANCE_VOTE) {
+            break;
+        }
+        vecKeys.push_back(key.second);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CGovernanceVoteDB::EraseVotes(const uint256& nParentHash)
+{
+    std::vector<CGovernanceVote> vecVotes;
+    if (!ReadVotes(nParentHash, vecVotes)) {
+        return false;
+    }
+
+    CDBBatch batch(&GetObfuscateKey());
+    for (size_t i = 0; i < vecVotes.size(); ++i) {
+        const uint256 nHash = vecVotes[i].GetHash();
+        batch.Erase(std::make_pair(DB_GOVERNANCE_VOTE, std::make_pair(nParentHash, nHash)));
+        batch.Erase(std::make_pair(DB_GOVERNANCE_MASTERNODE_VOTE, std::make_pair(nParentHash, std::make_pair(vecVotes[i].GetVinMasternode().prevout, nHash))));
+    }
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::EraseAll()
+{
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->SeekToFirst();
+
+    CDBBatch batch(&GetObfuscateKey());
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if (pcursor->GetKey(key) && key.first == DB_GOVERNANCE_VOTE) {
+            batch.Erase(key);
+        } else {
+            std::pair<char, std::pair<uint256, std::pair<COutPoint, uint256> > > keyMasternode;
+            if (pcursor->GetKey(keyMasternode) && keyMasternode.first == DB_GOVERNANCE_MASTERNODE_VOTE) {
+                batch.Erase(keyMasternode);
+            }
+        }
+        pcursor->Next();
+    }
+    return WriteBatch(batch, true);
+}
+
+int CGovernanceObjectVoteFile::nMaxMemoryVotes = DEFAULT_GOVERNANCE_VOTE_CACHE;
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
     : nMemoryVotes(0),
+      nStoredVotes(-1),
+      nParentHash(),
       listVotes(),
-      mapVoteIndex()
+      mapVoteIndex(),
+      setVerifiedVotes()
 {}
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other)
     : nMemoryVotes(other.nMemoryVotes),
+      nStoredVotes(other.nStoredVotes),
+      nParentHash(other.nParentHash),
       listVotes(other.listVotes),
-      mapVoteIndex()
+      mapVoteIndex(),
+      setVerifiedVotes(other.setVerifiedVotes)
 {
     RebuildIndex();
 }
 
-void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
+void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote, bool fVerified)
 {
+    uint256 nHash = vote.GetHash();
+    if(nParentHash.IsNull()) {
+        nParentHash = vote.GetParentHash();
+    }
+    if(pgovernancevotedb) {
+        if(pgovernancevotedb->WriteVote(vote)) {
+            if(nStoredVotes >= 0) {
+                ++nStoredVotes;
+            }
+        }
+        else {
+            LogPrintf("CGovernanceObjectVoteFile::AddVote -- failed to write vote %s\n", nHash.ToString());
+        }
+    }
     listVotes.push_front(vote);
-    mapVoteIndex[vote.GetHash()] = listVotes.begin();
+    mapVoteIndex[nHash] = listVotes.begin();
     ++nMemoryVotes;
+    if(fVerified) {
+        setVerifiedVotes.insert(nHash);
+    }
+    TrimVotes();
 }
 
 bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
 {
     vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
-        return false;
+    if(it != mapVoteIndex.end()) {
+        return true;
     }
-    return true;
+    if(pgovernancevotedb && !nParentHash.IsNull()) {
+        return pgovernancevotedb->HasVote(nParentHash, nHash);
+    }
+    return false;
 }
 
-bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& vote) const
+bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& vote)
 {
-    vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
-        return false;
+    vote_m_it it = mapVoteIndex.find(nHash);
+    if(it != mapVoteIndex.end()) {
+        // mark as most recently used
+        listVotes.splice(listVotes.begin(), listVotes, it->second);
+        vote = *(it->second);
+        return true;
     }
-    vote = *(it->second);
-    return true;
+    if(pgovernancevotedb && !nParentHash.IsNull() && pgovernancevotedb->ReadVote(nParentHash, nHash, vote)) {
+        CacheVote(vote);
+        return true;
+    }
+    return false;
+}
+
+int CGovernanceObjectVoteFile::GetVoteCount() const
+{
+    if(!pgovernancevotedb || nParentHash.IsNull()) {
+        return nMemoryVotes;
+    }
+    if(nStoredVotes < 0) {
+        std::vector<uint256> vecHashes;
+        pgovernancevotedb->ReadVoteHashes(nParentHash, vecHashes);
+        nStoredVotes = vecHashes.size();
+    }
+    return nStoredVotes;
 }
 
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 {
     std::vector<CGovernanceVote> vecResult;
+    std::set<uint256> setHashes;
     for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
         vecResult.push_back(*it);
+        setHashes.insert(it->GetHash());
+    }
+    if(pgovernancevotedb && !nParentHash.IsNull()) {
+        std::vector<CGovernanceVote> vecDiskVotes;
+        pgovernancevotedb->ReadVotes(nParentHash, vecDiskVotes);
+        for(size_t i = 0; i < vecDiskVotes.size(); ++i) {
+            if(setHashes.insert(vecDiskVotes[i].GetHash()).second) {
+                vecResult.push_back(vecDiskVotes[i]);
+            }
+        }
     }
     return vecResult;
 }
 
+std::vector<uint256> CGovernanceObjectVoteFile::GetVoteHashes() const
+{
+    std::vector<uint256> vecResult;
+    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
+        vecResult.push_back(it->GetHash());
+    }
+    if(pgovernancevotedb && !nParentHash.IsNull()) {
+        std::vector<uint256> vecDiskHashes;
+        pgovernancevotedb->ReadVoteHashes(nParentHash, vecDiskHashes);
+        for(size_t i = 0; i < vecDiskHashes.size(); ++i) {
+            if(!mapVoteIndex.count(vecDiskHashes[i])) {
+                vecResult.push_back(vecDiskHashes[i]);
+            }
+        }
+    }
+    return vecResult;
+}
+
+std::vector<uint256> CGovernanceObjectVoteFile::GetValidVoteHashes()
+{
+    std::vector<uint256> vecResult;
+    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
+        uint256 nHash = it->GetHash();
+        if(!setVerifiedVotes.count(nHash)) {
+            if(!it->IsValid(true)) {
+                continue;
+            }
+            setVerifiedVotes.insert(nHash);
+        }
+        vecResult.push_back(nHash);
+    }
+
+    if(pgovernancevotedb && !nParentHash.IsNull()) {
+        std::vector<uint256> vecDiskHashes;
+        pgovernancevotedb->ReadVoteHashes(nParentHash, vecDiskHashes);
+        for(size_t i = 0; i < vecDiskHashes.size(); ++i) {
+            const uint256& nHash = vecDiskHashes[i];
+            if(mapVoteIndex.count(nHash)) {
+                continue;
+            }
+            if(!setVerifiedVotes.count(nHash)) {
+                CGovernanceVote vote;
+                if(!pgovernancevotedb->ReadVote(nParentHash, nHash, vote) || !vote.IsValid(true)) {
+                    continue;
+                }
+                if((int)setVerifiedVotes.size() < 2 * std::max(nMaxMemoryVotes, 1)) {
+                    setVerifiedVotes.insert(nHash);
+                }
+            }
+            vecResult.push_back(nHash);
+        }
+    }
+    return vecResult;
+}
+
+void CGovernanceObjectVoteFile::ClearVerifiedVotes()
+{
+    setVerifiedVotes.clear();
+}
+
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const CTxIn& vinMasternode)
 {
     vote_l_it it = listVotes.begin();
     while(it != listVotes.end()) {
         if(it->GetVinMasternode() == vinMasternode) {
+            uint256 nHash = it->GetHash();
             --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
+            mapVoteIndex.erase(nHash);
+            setVerifiedVotes.erase(nHash);
             listVotes.erase(it++);
         }
         else {
             ++it;
         }
     }
+
+    if(pgovernancevotedb && !nParentHash.IsNull()) {
+        std::vector<uint256> vecHashes;
+        pgovernancevotedb->ReadMasternodeVoteHashes(nParentHash, vinMasternode.prevout, vecHashes);
+        for(size_t i = 0; i < vecHashes.size(); ++i) {
+            CGovernanceVote vote;
+            if(!pgovernancevotedb->ReadVote(nParentHash, vecHashes[i], vote) || !pgovernancevotedb->EraseVote(vote)) {
+                continue;
+            }
+            setVerifiedVotes.erase(vecHashes[i]);
+            if(nStoredVotes > 0) {
+                --nStoredVotes;
+            }
+        }
+    }
+}
+
+void CGovernanceObjectVoteFile::RemoveDiskVotes()
+{
+    if(pgovernancevotedb && !nParentHash.IsNull()) {
+        pgovernancevotedb->EraseVotes(nParentHash);
+    }
+    nStoredVotes = -1;
+    setVerifiedVotes.clear();
 }
 
 CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
 {
     nMemoryVotes = other.nMemoryVotes;
+    nStoredVotes = other.nStoredVotes;
+    nParentHash = other.nParentHash;
     listVotes = other.listVotes;
+    setVerifiedVotes = other.setVerifiedVotes;
     RebuildIndex();
     return *this;
 }
 
+void CGovernanceObjectVoteFile::TrimVotes()
+{
+    if(!pgovernancevotedb || nMaxMemoryVotes < 0) {
+        return;
+    }
+    while(nMemoryVotes > nMaxMemoryVotes) {
+        // already in the database, see AddVote
+        uint256 nHash = listVotes.back().GetHash();
+        mapVoteIndex.erase(nHash);
+        listVotes.pop_back();
+        --nMemoryVotes;
+        if((int)setVerifiedVotes.size() > 2 * std::max(nMaxMemoryVotes, 1)) {
+            setVerifiedVotes.erase(nHash);
+        }
+    }
+}
+
+void CGovernanceObjectVoteFile::CacheVote(const CGovernanceVote& vote)
+{
+    if(nMaxMemoryVotes == 0) {
+        return;
+    }
+    listVotes.push_front(vote);
+    mapVoteIndex[vote.GetHash()] = listVotes.begin();
+    ++nMemoryVotes;
+    TrimVotes();
+}
+
+void CGovernanceObjectVoteFile::StoreMissingVotes()
+{
+    if(!pgovernancevotedb) {
+        return;
+    }
+    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
+        if(!pgovernancevotedb->HasVote(it->GetParentHash(), it->GetHash()) && !pgovernancevotedb->WriteVote(*it)) {
+            LogPrintf("CGovernanceObjectVoteFile::StoreMissingVotes -- failed to write vote %s\n", it->GetHash().ToString());
+        }
+    }
+    nStoredVotes = -1;
+}
+
 void CGovernanceObjectVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
@@ -94,4 +436,21 @@ void CGovernanceObjectVoteFile::RebuildIndex()
             listVotes.erase(it++);
         }
     }
+
+    if(nParentHash.IsNull() && !listVotes.empty()) {
+        nParentHash = listVotes.front().GetParentHash();
+    }
+
+    // without a database, drop verification marks for votes that are gone
+    if(!pgovernancevotedb) {
+        std::set<uint256>::iterator itVerified = setVerifiedVotes.begin();
+        while(itVerified != setVerifiedVotes.end()) {
+            if(mapVoteIndex.count(*itVerified)) {
+                ++itVerified;
+            }
+            else {
+                setVerifiedVotes.erase(itVerified++);
+            }
+        }
+    }
 }
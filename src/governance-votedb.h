@@ -8,18 +8,60 @@
 
 #include <list>
 #include <map>
+#include <set>
 
+#include "dbwrapper.h"
 #include "governance-vote.h"
 #include "serialize.h"
 #include "uint256.h"
 
+/** Default for -governancevotecache, votes per governance object kept in memory */
+static const int DEFAULT_GOVERNANCE_VOTE_CACHE = 1000;
+
+/**
+ * All governance votes, keyed by the hash of the governance object they belong
+ * to and the vote hash. An index by object and masternode outpoint is kept next
+ * to them.
+ */
+class CGovernanceVoteDB : public CDBWrapper
+{
+public:
+    CGovernanceVoteDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CGovernanceVoteDB(const CGovernanceVoteDB&);
+    void operator=(const CGovernanceVoteDB&);
+
+public:
+    bool WriteVote(const CGovernanceVote& vote);
+    bool ReadVote(const uint256& nParentHash, const uint256& nHash, CGovernanceVote& vote) const;
+    bool HasVote(const uint256& nParentHash, const uint256& nHash) const;
+    bool EraseVote(const CGovernanceVote& vote);
+    /// All votes stored for the given governance object, in key order
+    bool ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotes);
+    bool ReadVoteHashes(const uint256& nParentHash, std::vector<uint256>& vecHashes);
+    bool ReadMasternodeVoteHashes(const uint256& nParentHash, const COutPoint& outpointMasternode, std::vector<uint256>& vecHashes);
+    /// Object and vote hashes of all stored votes, without reading the votes
+    bool ReadVoteKeys(std::vector<std::pair<uint256, uint256> >& vecKeys);
+    bool EraseVotes(const uint256& nParentHash);
+    bool EraseAll();
+};
+
+/** Global vote store, NULL if not opened */
+extern CGovernanceVoteDB* pgovernancevotedb;
+
 /**
  * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Every vote is written to pgovernancevotedb when it is added, which makes the
+ * database the authoritative copy. Recently received or accessed votes are also
+ * held in memory, up to a maximum after which the least recently used ones are
+ * dropped from memory. Lookups fall through to the database and votes read from
+ * it are kept in memory again.
+ *
+ * Only the votes held in memory are serialized. Loading them writes any of them
+ * that are missing from the database, e.g. after a crash. Without a database all
+ * votes are kept in memory.
  */
 class CGovernanceObjectVoteFile
 {
@@ -37,44 +79,80 @@ public: // Types
     typedef vote_m_t::const_iterator vote_m_cit;
 
 private:
-    static const int MAX_MEMORY_VOTES = -1;
+    /// Votes kept in memory per object, set from -governancevotecache
+    static int nMaxMemoryVotes;
 
     int nMemoryVotes;
 
+    /// Number of votes in pgovernancevotedb, counted on first use, -1 before
+    mutable int nStoredVotes;
+
+    /// Hash of the governance object, taken from the first vote added
+    uint256 nParentHash;
+
+    /// Most recently used votes first
     vote_l_t listVotes;
 
     vote_m_t mapVoteIndex;
 
+    /// Votes whose signature and masternode were checked, not serialized.
+    /// Marks of votes dropped from memory are kept up to twice the memory limit.
+    std::set<uint256> setVerifiedVotes;
+
 public:
     CGovernanceObjectVoteFile();
 
     CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other);
 
+    static void SetMaxMemoryVotes(int nMaxMemoryVotesIn) { nMaxMemoryVotes = nMaxMemoryVotesIn; }
+
     /**
-     * Add a vote to the file
+     * Add a vote to the file, fVerified if the vote already passed IsValid(true)
      */
-    void AddVote(const CGovernanceVote& vote);
+    void AddVote(const CGovernanceVote& vote, bool fVerified = false);
 
     /**
-     * Return true if the vote with this hash is currently cached in memory
+     * Return true if the vote with this hash is in memory or on disk
      */
     bool HasVote(const uint256& nHash) const;
 
     /**
-     * Retrieve a vote cached in memory
+     * Retrieve a vote from memory or disk
      */
-    bool GetVote(const uint256& nHash, CGovernanceVote& vote) const;
+    bool GetVote(const uint256& nHash, CGovernanceVote& vote);
 
-    int GetVoteCount() {
-        return nMemoryVotes;
-    }
+    int GetVoteCount() const;
 
+    /**
+     * Return all votes, reads every vote stored for the object
+     */
     std::vector<CGovernanceVote> GetVotes() const;
 
+    /**
+     * Return the hashes of all votes without reading the stored votes
+     */
+    std::vector<uint256> GetVoteHashes() const;
+
+    /**
+     * Return the hashes of all valid votes. Signatures are only checked for
+     * votes which were not verified before.
+     */
+    std::vector<uint256> GetValidVoteHashes();
+
+    /**
+     * Forget which votes were verified, e.g. after a voting masternode changed
+     */
+    void ClearVerifiedVotes();
+
     CGovernanceObjectVoteFile& operator=(const CGovernanceObjectVoteFile& other);
 
     void RemoveVotesFromMasternode(const CTxIn& vinMasternode);
 
+    /**
+     * Drop the votes stored on disk, when the governance object is deleted
+     */
+    void RemoveDiskVotes();
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -82,13 +160,24 @@ public:
     {
         READWRITE(nMemoryVotes);
         READWRITE(listVotes);
+        READWRITE(nParentHash);
         if(ser_action.ForRead()) {
             RebuildIndex();
+            StoreMissingVotes();
         }
     }
 private:
     void RebuildIndex();
 
+    /// Make sure the votes held in memory are in the database
+    void StoreMissingVotes();
+
+    /// Drop the least recently used votes from memory until the memory limit is met
+    void TrimVotes();
+
+    /// Keep a vote read from the database in memory as most recently used
+    void CacheVote(const CGovernanceVote& vote);
+
 };
 
 #endif
@@ -19,7 +19,7 @@ CGovernanceManager governance;
 
 int nSubmittedFinalBudget;
 
-const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-11";
+const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-13";
 
 CGovernanceManager::CGovernanceManager()
     : pCurrentBlockIndex(NULL),
@@ -465,6 +465,8 @@ void CGovernanceManager::UpdateCachesAndClean()
             continue;
         }
         it->second.ClearMasternodeVotes();
+        // a voting masternode went away or changed its key, verify the votes again on demand
+        it->second.GetVoteFile().ClearVerifiedVotes();
         it->second.fDirtyCache = true;
     }
 
@@ -536,6 +538,7 @@ void CGovernanceManager::UpdateCachesAndClean()
             if(pObj->nObjectType == GOVERNANCE_OBJECT_WATCHDOG) {
                 mapWatchdogObjects.erase(it->first);
             }
+            pObj->GetVoteFile().RemoveDiskVotes();
             mapObjects.erase(it++);
         } else {
             ++it;
@@ -754,7 +757,7 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
     LogPrint("gobject", "CGovernanceManager::Sync -- syncing to peer=%d, nProp = %s\n", pfrom->id, nProp.ToString());
 
     {
-        LOCK2(cs_main, cs);
+        LOCK(cs);
 
         if(nProp == uint256()) {
             // all valid objects, no votes
@@ -798,15 +801,13 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
             pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
             ++nObjCount;
 
-            std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                if(!vecVotes[i].IsValid(true)) {
-                    continue;
-                }
-                if(filter.contains(vecVotes[i].GetHash())) {
+            // votes are verified once when accepted, see CGovernanceObjectVoteFile
+            std::vector<uint256> vecVoteHashes = govobj.GetVoteFile().GetValidVoteHashes();
+            for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+                if(filter.contains(vecVoteHashes[i])) {
                     continue;
                 }
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
+                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVoteHashes[i]));
                 ++nVoteCount;
             }
         }
@@ -1063,9 +1064,9 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
 
         if(pObj) {
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
-            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                filter.insert(vecVotes[i].GetHash());
+            std::vector<uint256> vecVoteHashes = pObj->GetVoteFile().GetVoteHashes();
+            for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+                filter.insert(vecVoteHashes[i]);
             }
         }
     }
@@ -1212,13 +1213,35 @@ void CGovernanceManager::RebuildIndexes()
     mapVoteToObject.Clear();
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         CGovernanceObject& govobj = it->second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-        for(size_t i = 0; i < vecVotes.size(); ++i) {
-            mapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+        std::vector<uint256> vecVoteHashes = govobj.GetVoteFile().GetVoteHashes();
+        for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+            mapVoteToObject.Insert(vecVoteHashes[i], &govobj);
         }
     }
 }
 
+void CGovernanceManager::RemoveOrphanDiskVotes()
+{
+    if(!pgovernancevotedb) {
+        return;
+    }
+    // votes of objects which were deleted, or never made it into governance.dat
+    std::vector<std::pair<uint256, uint256> > vecKeys;
+    pgovernancevotedb->ReadVoteKeys(vecKeys);
+    std::set<uint256> setOrphanParents;
+    for(size_t i = 0; i < vecKeys.size(); ++i) {
+        if(!mapObjects.count(vecKeys[i].first)) {
+            setOrphanParents.insert(vecKeys[i].first);
+        }
+    }
+    for(std::set<uint256>::iterator it = setOrphanParents.begin(); it != setOrphanParents.end(); ++it) {
+        pgovernancevotedb->EraseVotes(*it);
+    }
+    if(!setOrphanParents.empty()) {
+        LogPrintf("CGovernanceManager::RemoveOrphanDiskVotes -- removed the votes of %d unknown objects\n", setOrphanParents.size());
+    }
+}
+
 int CGovernanceManager::GetMasternodeIndex(const CTxIn& masternodeVin)
 {
     LOCK(cs);
@@ -1262,6 +1285,7 @@ void CGovernanceManager::InitOnLoad()
     LOCK(cs);
     int64_t nStart = GetTimeMillis();
     LogPrintf("Preparing masternode indexes and governance triggers...\n");
+    RemoveOrphanDiskVotes();
     RebuildIndexes();
     AddCachedTriggers();
     LogPrintf("Masternode indexes and governance triggers prepared  %dms\n", GetTimeMillis() - nStart);
@@ -317,6 +317,9 @@ public:
         mapInvalidVotes.Clear();
         mapOrphanVotes.Clear();
         mapLastMasternodeObject.clear();
+        if(pgovernancevotedb) {
+            pgovernancevotedb->EraseAll();
+        }
     }
 
     std::string ToString() const;
@@ -422,6 +425,8 @@ private:
 
     void RebuildIndexes();
 
+    void RemoveOrphanDiskVotes();
+
     /// Returns MN index, handling the case of index rebuilds
     int GetMasternodeIndex(const CTxIn& masternodeVin);
 
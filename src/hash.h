@@ -266,6 +266,58 @@ public:
     }
 };
 
+/** Reads data from an underlying stream, while hashing the read data. */
+template<typename Source>
+class CHashVerifier : public CHashWriter
+{
+private:
+    Source* source;
+
+public:
+    CHashVerifier(Source* source_) : CHashWriter(source_->GetType(), source_->GetVersion()), source(source_) {}
+
+    CHashVerifier<Source>& read(char* pch, size_t nSize)
+    {
+        source->read(pch, nSize);
+        this->write(pch, nSize);
+        return (*this);
+    }
+
+    template<typename T>
+    CHashVerifier<Source>& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Writes data to an underlying stream, while hashing the written data. */
+template<typename Dest>
+class CHashedWriter : public CHashWriter
+{
+private:
+    Dest* dest;
+
+public:
+    CHashedWriter(Dest* dest_) : CHashWriter(dest_->GetType(), dest_->GetVersion()), dest(dest_) {}
+
+    CHashedWriter<Dest>& write(const char* pch, size_t nSize)
+    {
+        dest->write(pch, nSize);
+        CHashWriter::write(pch, nSize);
+        return (*this);
+    }
+
+    template<typename T>
+    CHashedWriter<Dest>& operator<<(const T& obj)
+    {
+        // Serialize to this stream
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
 /** Compute the 256-bit hash of an object's serialization. */
 template<typename T>
 uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL_VERSION)
@@ -1010,10 +1010,15 @@ uint256 CTxLockVote::GetHash() const
     return ss.GetHash();
 }
 
+std::string CTxLockVote::GetSignatureMessage() const
+{
+    return txHash.ToString() + outpoint.ToStringShort();
+}
+
 bool CTxLockVote::CheckSignature() const
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    std::string strMessage = GetSignatureMessage();
 
     masternode_info_t infoMn = mnodeman.GetMasternodeInfo(CTxIn(outpointMasternode));
 
@@ -1033,7 +1038,7 @@ bool CTxLockVote::CheckSignature() const
 bool CTxLockVote::Sign()
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    std::string strMessage = GetSignatureMessage();
 
     if(!darkSendSigner.SignMessage(strMessage, vchMasternodeSignature, activeMasternode.keyMasternode)) {
         LogPrintf("CTxLockVote::Sign -- SignMessage() failed\n");
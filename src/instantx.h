@@ -179,12 +179,14 @@ public:
     uint256 GetTxHash() const { return txHash; }
     COutPoint GetOutpoint() const { return outpoint; }
     COutPoint GetMasternodeOutpoint() const { return outpointMasternode; }
+    const std::vector<unsigned char>& GetSignature() const { return vchMasternodeSignature; }
     int64_t GetTimeCreated() const { return nTimeCreated; }
 
     bool IsValid(CNode* pnode) const;
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
     bool IsExpired(int nHeight) const;
 
+    std::string GetSignatureMessage() const;
     bool Sign();
     bool CheckSignature() const;
 
@@ -18,6 +18,7 @@
 #include "consensus/validation.h"
 #include "hash.h"
 #include "init.h"
+#include "mappedfile.h"
 #include "merkleblock.h"
 #include "net.h"
 #include "policy/policy.h"
@@ -45,6 +46,7 @@
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
+#include "sigcheckqueue.h"
 
 #include <sstream>
 
@@ -75,6 +77,7 @@ CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
 CChain chainActive;
+static CChainTipSnapshotPtr pChainTipSnapshot(new CChainTipSnapshot());
 CBlockIndex *pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
@@ -94,6 +97,7 @@ unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
+size_t nBlockServeCacheUsage = DEFAULT_BLOCK_SERVE_CACHE << 20;
 uint64_t nPruneTarget = 0;
 bool fAlerts = DEFAULT_ALERTS;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
@@ -585,6 +589,7 @@ void RegisterNodeSignals(CNodeSignals& nodeSignals)
 {
     nodeSignals.GetHeight.connect(&GetHeight);
     nodeSignals.ProcessMessages.connect(&ProcessMessages);
+    nodeSignals.ProcessWorkerMessages.connect(&ProcessWorkerMessages);
     nodeSignals.SendMessages.connect(&SendMessages);
     nodeSignals.InitializeNode.connect(&InitializeNode);
     nodeSignals.FinalizeNode.connect(&FinalizeNode);
@@ -594,6 +599,7 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals)
 {
     nodeSignals.GetHeight.disconnect(&GetHeight);
     nodeSignals.ProcessMessages.disconnect(&ProcessMessages);
+    nodeSignals.ProcessWorkerMessages.disconnect(&ProcessWorkerMessages);
     nodeSignals.SendMessages.disconnect(&SendMessages);
     nodeSignals.InitializeNode.disconnect(&InitializeNode);
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
@@ -1089,7 +1095,7 @@ std::string FormatStateMessage(const CValidationState &state)
 }
 
 bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-                              bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee,
+                              bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit, bool fRejectAbsurdFee,
                               std::vector<uint256>& vHashTxnToUncache, bool fDryRun)
 {
     AssertLockHeld(cs_main);
@@ -1282,7 +1288,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             }
         }
 
-        CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx), inChainInputValue, fSpendsCoinbase, nSigOps, lp);
+        CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height(), pool.HasNoInputsOf(tx), inChainInputValue, fSpendsCoinbase, nSigOps, lp);
         unsigned int nSize = entry.GetTxSize();
 
         // Check that the transaction doesn't have an excessive number of
@@ -1383,20 +1389,6 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
                 // Save these to avoid repeated lookups
                 setIterConflicting.insert(mi);
 
-                // If this entry is "dirty", then we don't have descendant
-                // state for this transaction, which means we probably have
-                // lots of in-mempool descendants.
-                // Don't allow replacements of dirty transactions, to ensure
-                // that we don't spend too much time walking descendants.
-                // This should be rare.
-                if (mi->IsDirty()) {
-                    return state.DoS(0,
-                            error("AcceptToMemoryPool: rejecting replacement %s; cannot replace tx %s with untracked descendants",
-                                hash.ToString(),
-                                mi->GetTx().GetHash().ToString()),
-                            REJECT_NONSTANDARD, "too many potential replacements");
-                }
-
                 // Don't allow the replacement to reduce the feerate of the
                 // mempool.
                 //
@@ -1527,7 +1519,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
                     FormatMoney(nModifiedFees - nConflictingFees),
                     (int)nSize - (int)nConflictingSize);
         }
-        pool.RemoveStaged(allConflicting);
+        pool.RemoveStaged(allConflicting, false);
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry, setAncestors, !IsInitialBlockDownload());
@@ -1555,11 +1547,12 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
     return true;
 }
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
-                        bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee, bool fDryRun)
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+                                bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit,
+                                bool fRejectAbsurdFee, bool fDryRun)
 {
     std::vector<uint256> vHashTxToUncache;
-    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, fOverrideMempoolLimit, fRejectAbsurdFee, vHashTxToUncache, fDryRun);
+    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, fOverrideMempoolLimit, fRejectAbsurdFee, vHashTxToUncache, fDryRun);
     if (!res || fDryRun) {
         if(!res) LogPrint("mempool", "%s: %s %s\n", __func__, tx.GetHash().ToString(), state.GetRejectReason());
         BOOST_FOREACH(const uint256& hashTx, vHashTxToUncache)
@@ -1568,6 +1561,12 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return res;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+                        bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectAbsurdFee, bool fDryRun)
+{
+    return AcceptToMemoryPoolWithTime(pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), fOverrideMempoolLimit, fRejectAbsurdFee, fDryRun);
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
 {
     if (!fTimestampIndex)
@@ -1594,29 +1593,68 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 }
 
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     const CAddressIndexKey *pFrom, size_t nLimit)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, pFrom, nLimit))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressBalanceIndex(addressHash, type, value))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentKey *pFrom, size_t nLimit)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, pFrom, nLimit))
         return error("unable to get txids for address");
 
     return true;
 }
 
+/** Finalized block and undo files mapped read-only */
+static CMappedFilePool mappedBlockFiles;
+
+void SetMappedBlockFiles(unsigned int nFiles)
+{
+    mappedBlockFiles.SetMaxFiles(nFiles);
+}
+
+/**
+ * Return the mapping of the blk or rev file containing pos. Only files before
+ * the last one are mapped, the last file is still appended to and gets
+ * truncated when it is finalized. Empty if the file isn't mapped, readers then
+ * fall back to reading the file.
+ */
+static boost::shared_ptr<const CMappedFile> MapDiskFile(const CDiskBlockPos& pos, const char* prefix)
+{
+    if (pos.IsNull())
+        return boost::shared_ptr<const CMappedFile>();
+    {
+        LOCK(cs_LastBlockFile);
+        if (pos.nFile >= nLastBlockFile)
+            return boost::shared_ptr<const CMappedFile>();
+    }
+    return mappedBlockFiles.Get(GetBlockPosFilename(pos, prefix), pos.nPos);
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -1632,16 +1670,28 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            boost::shared_ptr<const CMappedFile> mapped = MapDiskFile(postx, "blk");
+            if (mapped) {
+                try {
+                    CMappedFileStream file(mapped, postx.nPos, SER_DISK, CLIENT_VERSION);
+                    file >> header;
+                    file.ignore(postx.nTxOffset);
+                    file >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
+            } else {
+                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                if (file.IsNull())
+                    return error("%s: OpenBlockFile failed", __func__);
+                try {
+                    file >> header;
+                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                    file >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
             }
             hashBlock = header.GetHash();
             if (txOut.GetHash() != hash)
@@ -1713,17 +1763,32 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
-    // Read block
-    try {
-        filein >> block;
+    bool fRead = false;
+    boost::shared_ptr<const CMappedFile> mapped = MapDiskFile(pos, "blk");
+    if (mapped) {
+        try {
+            CMappedFileStream filein(mapped, pos.nPos, SER_DISK, CLIENT_VERSION);
+            filein >> block;
+            fRead = true;
+        }
+        catch (const std::exception& e) {
+            LogPrint("db", "%s: mapped read failed - %s at %s\n", __func__, e.what(), pos.ToString());
+        }
     }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+
+    if (!fRead) {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -1743,6 +1808,52 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+template <typename Stream>
+static bool ReadRawBlock(Stream& filein, CDataStream& blockData, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    try {
+        CMessageHeader::MessageStartChars blkStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blkStart) >> nSize;
+
+        if (memcmp(blkStart, messageStart, MESSAGE_START_SIZE) != 0)
+            return error("%s: block magic mismatch at %s", __func__, pos.ToString());
+        if (nSize > MAX_SIZE)
+            return error("%s: block size %u too large at %s", __func__, nSize, pos.ToString());
+
+        blockData.resize(nSize);
+        if (nSize > 0)
+            filein.read(&blockData[0], nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(CDataStream& blockData, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    blockData.clear();
+
+    // The block is preceded by the index header written by WriteBlockToDisk
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s: no block at %s", __func__, pos.ToString());
+    CDiskBlockPos hpos(pos.nFile, pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int));
+
+    boost::shared_ptr<const CMappedFile> mapped = MapDiskFile(hpos, "blk");
+    if (mapped) {
+        CMappedFileStream filein(mapped, hpos.nPos, SER_DISK, CLIENT_VERSION);
+        return ReadRawBlock(filein, blockData, pos, messageStart);
+    }
+
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    return ReadRawBlock(filein, blockData, pos, messageStart);
+}
+
 double ConvertBitsToDouble(unsigned int nBits)
 {
     int nShift = (nBits >> 24) & 0xff;
@@ -1916,12 +2027,13 @@ void CheckForkWarningConditionsOnNewFork(CBlockIndex* pindexNewForkTip)
     CheckForkWarningConditions();
 }
 
+/** Misbehavior reported by message workers while cs_main was busy, applied by SendMessages */
+static CCriticalSection cs_vPendingMisbehavior;
+static std::vector<std::pair<NodeId, int> > vPendingMisbehavior;
+
 // Requires cs_main.
-void Misbehaving(NodeId pnode, int howmuch)
+static void AddMisbehavior(NodeId pnode, int howmuch)
 {
-    if (howmuch == 0)
-        return;
-
     CNodeState *state = State(pnode);
     if (state == NULL)
         return;
@@ -1930,10 +2042,33 @@ void Misbehaving(NodeId pnode, int howmuch)
     int banscore = GetArg("-banscore", DEFAULT_BANSCORE_THRESHOLD);
     if (state->nMisbehavior >= banscore && state->nMisbehavior - howmuch < banscore)
     {
-        LogPrintf("%s: %s (%d -> %d) BAN THRESHOLD EXCEEDED\n", __func__, state->name, state->nMisbehavior-howmuch, state->nMisbehavior);
+        LogPrintf("Misbehaving: %s (%d -> %d) BAN THRESHOLD EXCEEDED\n", state->name, state->nMisbehavior-howmuch, state->nMisbehavior);
         state->fShouldBan = true;
     } else
-        LogPrintf("%s: %s (%d -> %d)\n", __func__, state->name, state->nMisbehavior-howmuch, state->nMisbehavior);
+        LogPrintf("Misbehaving: %s (%d -> %d)\n", state->name, state->nMisbehavior-howmuch, state->nMisbehavior);
+}
+
+void Misbehaving(NodeId pnode, int howmuch)
+{
+    if (howmuch == 0)
+        return;
+
+    if (!IsMessageWorkerThread()) {
+        LOCK(cs_main);
+        AddMisbehavior(pnode, howmuch);
+        return;
+    }
+
+    // Masternode messages are processed on message workers, often while
+    // holding the lock of their manager. Waiting for cs_main there could
+    // deadlock, so the score is left to SendMessages if cs_main is busy.
+    TRY_LOCK(cs_main, lockMain);
+    if (!lockMain) {
+        LOCK(cs_vPendingMisbehavior);
+        vPendingMisbehavior.push_back(std::make_pair(pnode, howmuch));
+        return;
+    }
+    AddMisbehavior(pnode, howmuch);
 }
 
 void static InvalidChainFound(CBlockIndex* pindexNew)
@@ -2162,19 +2297,38 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenBlockFile failed", __func__);
-
-    // Read block
     uint256 hashChecksum;
-    try {
-        filein >> blockundo;
-        filein >> hashChecksum;
+    bool fRead = false;
+
+    // Undo data may still be appended to older rev files, so data beyond
+    // the end of the mapping is read from the file
+    boost::shared_ptr<const CMappedFile> mapped = MapDiskFile(pos, "rev");
+    if (mapped) {
+        try {
+            CMappedFileStream filein(mapped, pos.nPos, SER_DISK, CLIENT_VERSION);
+            filein >> blockundo;
+            filein >> hashChecksum;
+            fRead = true;
+        }
+        catch (const std::exception& e) {
+            LogPrint("db", "%s: mapped read failed - %s at %s\n", __func__, e.what(), pos.ToString());
+        }
     }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+
+    if (!fRead) {
+        // Open history file to read
+        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed", __func__);
+
+        // Read block
+        try {
+            filein >> blockundo;
+            filein >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Verify checksum
@@ -2379,11 +2533,16 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
         if (!pblocktree->EraseAddressIndex(addressIndex)) {
             return AbortNode(state, "Failed to delete address index");
         }
+        if (!pblocktree->UpdateAddressBalanceIndex(addressIndex, pindex, true)) {
+            return AbortNode(state, "Failed to write address balance index");
+        }
         if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
     }
 
+    coinbasePayees.RemoveBlock(pindex);
+
     return fClean;
 }
 
@@ -2419,6 +2578,53 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CHeaderPoWCheck> headercheckqueue(16);
+/** A check queue has a single master; this serializes its users */
+static CCriticalSection cs_headercheckqueue;
+/** Number of headers per check, a multiple of the Neoscrypt SIMD lanes */
+static const unsigned int HEADER_CHECK_CHUNK = 16;
+
+void ThreadHeaderCheck() {
+    RenameThread("cerberus-hdrcheck");
+    headercheckqueue.Thread();
+}
+
+bool CHeaderPoWCheck::operator()() {
+    GetBlockHeaderHashes(pheaders, nCount, phashes);
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    for (unsigned int i = 0; i < nCount; i++)
+        if (!CheckProofOfWork(phashes[i], pheaders[i].nBits, consensusParams))
+            return false;
+    return true;
+}
+
+bool CheckBlockHeadersPoW(const std::vector<CBlockHeader>& headers, std::vector<uint256>& vHashesOut, CValidationState& state)
+{
+    vHashesOut.assign(headers.size(), uint256());
+
+    std::vector<CHeaderPoWCheck> vChecks;
+    vChecks.reserve(headers.size() / HEADER_CHECK_CHUNK + 1);
+    for (unsigned int i = 0; i < headers.size(); i += HEADER_CHECK_CHUNK)
+        vChecks.push_back(CHeaderPoWCheck(&headers[i], &vHashesOut[i], std::min(HEADER_CHECK_CHUNK, (unsigned int)headers.size() - i)));
+
+    bool fOk = true;
+    if (nScriptCheckThreads) {
+        LOCK(cs_headercheckqueue);
+        CCheckQueueControl<CHeaderPoWCheck> control(&headercheckqueue);
+        control.Add(vChecks);
+        fOk = control.Wait();
+    } else {
+        BOOST_FOREACH(CHeaderPoWCheck& check, vChecks)
+            if (fOk)
+                fOk = check();
+    }
+
+    if (!fOk)
+        return state.DoS(50, error("CheckBlockHeadersPoW(): proof of work failed"),
+                         REJECT_INVALID, "high-hash");
+    return true;
+}
+
 //
 // Called periodically asynchronously; alerts if it smells like
 // we're being fed a bad chain (blocks being generated much
@@ -2844,6 +3050,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             return AbortNode(state, "Failed to write address index");
         }
 
+        if (!pblocktree->UpdateAddressBalanceIndex(addressIndex, pindex, false)) {
+            return AbortNode(state, "Failed to write address balance index");
+        }
+
         if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
@@ -2860,6 +3070,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
+    if (!fLiteMode)
+        coinbasePayees.AddBlock(block, pindex);
+
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint("bench", "    - Index writing: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeIndex * 0.000001);
 
@@ -2995,10 +3208,50 @@ void PruneAndFlush() {
     FlushStateToDisk(state, FLUSH_STATE_NONE);
 }
 
+CChainTipSnapshot::CChainTipSnapshot(const CBlockIndex* pindexIn) : pindex(pindexIn)
+{
+    if (pindex == NULL) {
+        nHeight = -1;
+        nTime = 0;
+        nMedianTimePast = 0;
+        return;
+    }
+    nHeight = pindex->nHeight;
+    hashBlock = pindex->GetBlockHash();
+    nChainWork = pindex->nChainWork;
+    nTime = pindex->GetBlockTime();
+    nMedianTimePast = pindex->GetMedianTimePast();
+}
+
+bool CChainTipSnapshot::Contains(const CBlockIndex* pindexIn) const
+{
+    return pindexIn != NULL && (*this)[pindexIn->nHeight] == pindexIn;
+}
+
+const CBlockIndex* CChainTipSnapshot::operator[](int nHeightIn) const
+{
+    if (pindex == NULL || nHeightIn < 0 || nHeightIn > nHeight)
+        return NULL;
+    return pindex->GetAncestor(nHeightIn);
+}
+
+CChainTipSnapshotPtr GetChainTipSnapshot()
+{
+    return boost::atomic_load(&pChainTipSnapshot);
+}
+
+/** Publish a fresh snapshot of chainActive's tip; call after every SetTip. */
+static void PublishChainTipSnapshot()
+{
+    CChainTipSnapshotPtr pSnapshot(new CChainTipSnapshot(chainActive.Tip()));
+    boost::atomic_store(&pChainTipSnapshot, pSnapshot);
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex *pindexNew) {
     const CChainParams& chainParams = Params();
     chainActive.SetTip(pindexNew);
+    PublishChainTipSnapshot();
 
     // New best block
     nTimeBestReceived = GetTime();
@@ -3166,6 +3419,8 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
+    LogPrint("bench", "- PoW hashes: %u for this block [%u evaluations, %u cache hits in total]\n", pblock->GetHashEvaluations(),
+        CBlockHeader::GetTotalHashEvaluations(), CBlockHeader::GetTotalHashCacheHits());
     return true;
 }
 
@@ -4127,6 +4382,8 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
 {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        mappedBlockFiles.Erase(GetBlockPosFilename(pos, "blk"));
+        mappedBlockFiles.Erase(GetBlockPosFilename(pos, "rev"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -4359,6 +4616,19 @@ bool static LoadBlockIndexDB()
     if (it == mapBlockIndex.end())
         return true;
     chainActive.SetTip(it->second);
+    PublishChainTipSnapshot();
+
+    // Address indexes from before the balance index are summed up once
+    if (fAddressIndex) {
+        bool fAddressBalanceIndex = false;
+        pblocktree->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
+        if (!fAddressBalanceIndex) {
+            LogPrintf("%s: building address balance index...\n", __func__);
+            if (!pblocktree->BuildAddressBalanceIndex(chainActive.Height(), chainActive.Tip()->GetBlockHash()))
+                return error("%s: failed to build address balance index", __func__);
+            pblocktree->WriteFlag("addressbalanceindex", true);
+        }
+    }
 
     PruneBlockIndexCandidates();
 
@@ -4485,6 +4755,8 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
+    // the snapshot points into mapBlockIndex, drop it before freeing the entries
+    PublishChainTipSnapshot();
     BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
         delete entry.second;
     }
@@ -4518,6 +4790,7 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    pblocktree->WriteFlag("addressbalanceindex", fAddressIndex);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -4992,6 +5265,58 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return true;
 }
 
+namespace {
+
+/**
+ * Serialized blocks recently sent to peers, most recently used first.
+ * When a new block propagates or several peers sync the same range, the
+ * blocks are sent from here instead of being read, checked and serialized
+ * again for every request.
+ */
+class CBlockServeCache
+{
+private:
+    typedef std::list<std::pair<uint256, CDataStream> > list_t;
+    list_t listBlocks;
+    std::map<uint256, list_t::iterator> mapBlocks;
+    size_t nUsage;
+
+public:
+    CBlockServeCache() : nUsage(0) {}
+
+    const CDataStream* Get(const uint256& hash)
+    {
+        std::map<uint256, list_t::iterator>::iterator it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return NULL;
+        listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+        return &it->second->second;
+    }
+
+    /** Store the block unless it does not fit, the result stays valid until the next Add */
+    const CDataStream* Add(const uint256& hash, const CDataStream& blockData, size_t nMaxUsage)
+    {
+        size_t nSize = blockData.size();
+        if (nSize > nMaxUsage)
+            return NULL;
+
+        while (!listBlocks.empty() && nUsage + nSize > nMaxUsage) {
+            nUsage -= listBlocks.back().second.size();
+            mapBlocks.erase(listBlocks.back().first);
+            listBlocks.pop_back();
+        }
+
+        listBlocks.push_front(std::make_pair(hash, blockData));
+        mapBlocks[hash] = listBlocks.begin();
+        nUsage += nSize;
+        return &listBlocks.front().second;
+    }
+};
+
+CBlockServeCache blockServeCache GUARDED_BY(cs_main);
+
+} // anon namespace
+
 void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
@@ -5046,17 +5371,26 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
+                    // Send block from the serve cache, or the stored bytes from disk
+                    CDataStream blockData(SER_NETWORK, PROTOCOL_VERSION);
+                    const CDataStream* pblockData = blockServeCache.Get(inv.hash);
+                    if (!pblockData) {
+                        if (!ReadRawBlockFromDisk(blockData, (*mi).second->GetBlockPos(), Params().MessageStart()))
+                            assert(!"cannot load block from disk");
+                        pblockData = blockServeCache.Add(inv.hash, blockData, nBlockServeCacheUsage);
+                        if (!pblockData)
+                            pblockData = &blockData;
+                    }
                     if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage(NetMsgType::BLOCK, block);
+                        pfrom->PushMessage(NetMsgType::BLOCK, *pblockData);
                     else // MSG_FILTERED_BLOCK)
                     {
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter)
                         {
+                            CBlock block;
+                            CDataStream ss(pblockData->begin(), pblockData->end(), SER_NETWORK, PROTOCOL_VERSION);
+                            ss >> block;
                             CMerkleBlock merkleBlock(block, *pfrom->pfilter);
                             pfrom->PushMessage(NetMsgType::MERKLEBLOCK, merkleBlock);
                             // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
@@ -5088,20 +5422,20 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             }
             else if (inv.IsKnownType())
             {
-                // Send stream from relay memory
+                // Send message from relay memory
                 bool pushed = false;
                 {
-                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    CSerializedNetMsgPtr msg;
                     {
                         LOCK(cs_mapRelay);
-                        map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
-                        if (mi != mapRelay.end()) {
-                            ss += (*mi).second;
-                            pushed = true;
-                        }
+                        map<CInv, CSerializedNetMsgPtr>::iterator mi = mapRelay.find(inv);
+                        if (mi != mapRelay.end())
+                            msg = (*mi).second;
+                    }
+                    if (msg) {
+                        pfrom->PushSerializedMessage(msg);
+                        pushed = true;
                     }
-                    if(pushed)
-                        pfrom->PushMessage(inv.GetCommand(), ss);
                 }
 
                 if (!pushed && inv.type == MSG_TX) {
@@ -5201,7 +5535,8 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
                         ss << mapDarksendBroadcastTxes[inv.hash];
-                        pfrom->PushMessage(NetMsgType::DSTX, ss);
+                        // back into relay memory, the next peers asking share this message
+                        pfrom->PushSerializedMessage(AddRelayMessage(inv, ss));
                         pushed = true;
                     }
                 }
@@ -5963,6 +6298,16 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Context-free checks of the whole message on the header check threads,
+        // before taking cs_main. The hashes are memoized in the headers, so only
+        // the contextual checks are left for AcceptBlockHeader.
+        std::vector<uint256> vHashes;
+        CValidationState statePoW;
+        bool fPoWValid = CheckBlockHeadersPoW(headers, vHashes, statePoW);
+        bool fContinuous = true;
+        for (unsigned int n = 1; n < nCount && fContinuous && fPoWValid; n++)
+            fContinuous = headers[n].hashPrevBlock == vHashes[n - 1];
+
         LOCK(cs_main);
 
         if (nCount == 0) {
@@ -5970,13 +6315,21 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             return true;
         }
 
+        if (!fPoWValid) {
+            int nDoS;
+            if (statePoW.IsInvalid(nDoS) && nDoS > 0)
+                Misbehaving(pfrom->GetId(), nDoS);
+            return error("invalid headers received from peer=%d: %s", pfrom->id, FormatStateMessage(statePoW));
+        }
+
+        if (!fContinuous) {
+            Misbehaving(pfrom->GetId(), 20);
+            return error("non-continuous headers sequence");
+        }
+
         CBlockIndex *pindexLast = NULL;
         BOOST_FOREACH(const CBlockHeader& header, headers) {
             CValidationState state;
-            if (pindexLast != NULL && header.hashPrevBlock != pindexLast->GetBlockHash()) {
-                Misbehaving(pfrom->GetId(), 20);
-                return error("non-continuous headers sequence");
-            }
             if (!AcceptBlockHeader(header, state, chainparams, &pindexLast)) {
                 int nDoS;
                 if (state.IsInvalid(nDoS)) {
@@ -6344,8 +6697,45 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     return true;
 }
 
+/** Maximum number of messages a message worker processes for a peer in one go */
+static const unsigned int MAX_WORKER_MESSAGES = 16;
+
+static CCriticalSection cs_darksendMessages;
+static CCriticalSection cs_masternodeMessages;
+static CCriticalSection cs_paymentMessages;
+static CCriticalSection cs_governanceMessages;
+static CCriticalSection cs_syncMessages;
+
+/**
+ * Messages which are only handled by the masternode subsystems are left to
+ * the message workers, so PrivateSend mixing or governance can't hold up
+ * block, transaction and InstantSend relay. The subsystems were written for
+ * a single message handler thread, so each of them gets one message at a
+ * time, which is what the returned lock is for. Returns NULL for messages
+ * which stay with the message handler.
+ */
+static CCriticalSection* GetMessageWorkerLock(const std::string& strCommand)
+{
+    if (strCommand == NetMsgType::DSACCEPT || strCommand == NetMsgType::DSQUEUE ||
+        strCommand == NetMsgType::DSVIN || strCommand == NetMsgType::DSSTATUSUPDATE ||
+        strCommand == NetMsgType::DSSIGNFINALTX || strCommand == NetMsgType::DSFINALTX ||
+        strCommand == NetMsgType::DSCOMPLETE)
+        return &cs_darksendMessages;
+    if (strCommand == NetMsgType::MNANNOUNCE || strCommand == NetMsgType::MNPING ||
+        strCommand == NetMsgType::DSEG || strCommand == NetMsgType::MNVERIFY)
+        return &cs_masternodeMessages;
+    if (strCommand == NetMsgType::MASTERNODEPAYMENTVOTE || strCommand == NetMsgType::MASTERNODEPAYMENTSYNC)
+        return &cs_paymentMessages;
+    if (strCommand == NetMsgType::MNGOVERNANCEOBJECT || strCommand == NetMsgType::MNGOVERNANCEOBJECTVOTE ||
+        strCommand == NetMsgType::MNGOVERNANCESYNC)
+        return &cs_governanceMessages;
+    if (strCommand == NetMsgType::SYNCSTATUSCOUNT)
+        return &cs_syncMessages;
+    return NULL;
+}
+
 // requires LOCK(cs_vRecvMsg)
-bool ProcessMessages(CNode* pfrom)
+static bool ProcessNextMessages(CNode* pfrom, bool fWorker)
 {
     const CChainParams& chainparams = Params();
     //if (fDebug)
@@ -6361,12 +6751,18 @@ bool ProcessMessages(CNode* pfrom)
     //
     bool fOk = true;
 
-    if (!pfrom->vRecvGetData.empty())
-        ProcessGetData(pfrom, chainparams.GetConsensus());
+    if (!fWorker) {
+        if (!pfrom->vRecvGetData.empty())
+            ProcessGetData(pfrom, chainparams.GetConsensus());
 
-    // this maintains the order of responses
-    if (!pfrom->vRecvGetData.empty()) return fOk;
+        // this maintains the order of responses
+        if (!pfrom->vRecvGetData.empty()) return fOk;
+
+        // let the workers recover masternode message signatures while we process earlier messages
+        QueueSignatureChecks(pfrom);
+    }
 
+    unsigned int nProcessed = 0;
     std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
     while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end()) {
         // Don't bother if send buffer is too full to respond anyway
@@ -6385,6 +6781,15 @@ bool ProcessMessages(CNode* pfrom)
         if (!msg.complete())
             break;
 
+        // A worker takes over the peer at the first masternode message and
+        // hands it back at the next other one, which keeps the order of the
+        // peer's messages.
+        CCriticalSection* pcsWorker = pfrom->fSuccessfullyConnected ? GetMessageWorkerLock(msg.hdr.GetCommand()) : NULL;
+        if (fWorker && (pcsWorker == NULL || nProcessed >= MAX_WORKER_MESSAGES))
+            break;
+        if (!fWorker && pcsWorker != NULL && QueueMessageWorker(pfrom))
+            break;
+
         // at this point, any failure means we can delete the current message
         it++;
 
@@ -6422,7 +6827,12 @@ bool ProcessMessages(CNode* pfrom)
         bool fRet = false;
         try
         {
-            fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
+            if (pcsWorker != NULL) {
+                LOCK(*pcsWorker);
+                fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
+            } else {
+                fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
+            }
             boost::this_thread::interruption_point();
         }
         catch (const std::ios_base::failure& e)
@@ -6455,7 +6865,10 @@ bool ProcessMessages(CNode* pfrom)
         if (!fRet)
             LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->id);
 
-        break;
+        // the message handler takes one message per peer at a time
+        if (!fWorker)
+            break;
+        nProcessed++;
     }
 
     // In case the connection got shut down, its receive buffer was wiped
@@ -6465,6 +6878,16 @@ bool ProcessMessages(CNode* pfrom)
     return fOk;
 }
 
+bool ProcessMessages(CNode* pfrom)
+{
+    return ProcessNextMessages(pfrom, false);
+}
+
+bool ProcessWorkerMessages(CNode* pfrom)
+{
+    return ProcessNextMessages(pfrom, true);
+}
+
 
 bool SendMessages(CNode* pto)
 {
@@ -6540,6 +6963,13 @@ bool SendMessages(CNode* pto)
                 pto->PushMessage(NetMsgType::ADDR, vAddr);
         }
 
+        {
+            LOCK(cs_vPendingMisbehavior);
+            for (size_t i = 0; i < vPendingMisbehavior.size(); i++)
+                AddMisbehavior(vPendingMisbehavior[i].first, vPendingMisbehavior[i].second);
+            vPendingMisbehavior.clear();
+        }
+
         CNodeState &state = *State(pto->GetId());
         if (state.fShouldBan) {
             if (pto->fWhitelisted)
@@ -6847,12 +7277,168 @@ ThresholdState VersionBitsTipState(const Consensus::Params& params, Consensus::D
     return VersionBitsState(chainActive.Tip(), params, pos, versionbitscache);
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+
+/** Double-SHA256 of the first nSize bytes of file, read in chunks. Leaves the file positioned at nSize. */
+static bool HashFileRange(FILE* file, uint64_t nSize, uint256& hashRet)
+{
+    if (fflush(file) != 0 || fseek(file, 0, SEEK_SET) != 0)
+        return false;
+
+    CHash256 hasher;
+    std::vector<unsigned char> vchBuf(1 << 16);
+    while (nSize > 0) {
+        size_t nRead = std::min<uint64_t>(nSize, vchBuf.size());
+        if (fread(&vchBuf[0], 1, nRead, file) != nRead)
+            return false;
+        hasher.Write(&vchBuf[0], nRead);
+        nSize -= nRead;
+    }
+    hasher.Finalize(hashRet.begin());
+    return true;
+}
+
+/**
+ * mempool.dat layout:
+ *   version, network magic, mapDeltas, number of transactions,
+ *   (transaction, entry time) parents first, double-SHA256 of everything before it.
+ * The fee estimator keeps its own fee_estimates.dat, which is loaded before any
+ * block is connected.
+ */
+bool DumpMempool()
+{
+    int64_t nStart = GetTimeMicros();
+
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    std::vector<std::pair<CTransaction, int64_t> > vEntries;
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+    }
+    mempool.queryEntries(vEntries);
+
+    int64_t nMid = GetTimeMicros();
+
+    boost::filesystem::path pathTmp = GetDataDir() / "mempool.dat.new";
+    try {
+        FILE* file = fopen(pathTmp.string().c_str(), "wb");
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull())
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
+
+        // checksum the data as it is written and append it
+        CHashedWriter<CAutoFile> hashedout(&fileout);
+        hashedout << MEMPOOL_DUMP_VERSION;
+        hashedout << FLATDATA(Params().MessageStart());
+        hashedout << mapDeltas;
+        hashedout << (uint64_t)vEntries.size();
+        for (size_t i = 0; i < vEntries.size(); i++) {
+            hashedout << vEntries[i].first;
+            hashedout << vEntries[i].second;
+        }
+        fileout << hashedout.GetHash();
+        FileCommit(fileout.Get());
+        fileout.fclose();
+
+        if (!RenameOver(pathTmp, GetDataDir() / "mempool.dat"))
+            return error("%s: Failed to rename %s", __func__, pathTmp.string());
+    } catch (const std::exception& e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+
+    int64_t nLast = GetTimeMicros();
+    LogPrintf("Dumped mempool: %d transactions, %d deltas, %gs to copy, %gs to dump\n",
+              vEntries.size(), mapDeltas.size(), (nMid - nStart) * 0.000001, (nLast - nMid) * 0.000001);
+    return true;
+}
+
+bool LoadMempool()
+{
+    int64_t nStart = GetTimeMillis();
+    int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+
+    boost::filesystem::path path = GetDataDir() / "mempool.dat";
+    FILE* file = fopen(path.string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    int64_t nCount = 0;
+    int64_t nFailed = 0;
+    int64_t nExpired = 0;
+    int64_t nNow = GetTime();
+
+    try {
+        // verify the checksum before touching the mempool
+        uint64_t nFileSize = boost::filesystem::file_size(path);
+        if (nFileSize < sizeof(uint256))
+            return error("%s: File %s is too short", __func__, path.string());
+        uint256 hashData, hashIn;
+        if (!HashFileRange(filein.Get(), nFileSize - sizeof(uint256), hashData))
+            return error("%s: Failed to read %s", __func__, path.string());
+        filein >> hashIn;
+        if (hashIn != hashData)
+            return error("%s: Checksum mismatch, data corrupted", __func__);
+        if (fseek(filein.Get(), 0, SEEK_SET) != 0)
+            return error("%s: Failed to rewind %s", __func__, path.string());
+
+        uint64_t nVersion;
+        filein >> nVersion;
+        if (nVersion != MEMPOOL_DUMP_VERSION)
+            return error("%s: Unknown mempool file version %d", __func__, nVersion);
+
+        unsigned char pchMsgTmp[4];
+        filein >> FLATDATA(pchMsgTmp);
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            return error("%s: Invalid network magic number", __func__);
+
+        std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+        filein >> mapDeltas;
+        for (std::map<uint256, std::pair<double, CAmount> >::const_iterator it = mapDeltas.begin(); it != mapDeltas.end(); ++it) {
+            mempool.PrioritiseTransaction(it->first, it->first.ToString(), it->second.first, it->second.second);
+        }
+
+        uint64_t nTxs;
+        filein >> nTxs;
+        while (nTxs--) {
+            CTransaction tx;
+            int64_t nTime;
+            filein >> tx;
+            filein >> nTime;
+
+            if (nTime + nExpiryTimeout > nNow) {
+                // take cs_main per transaction so block processing is not held up
+                LOCK(cs_main);
+                CValidationState state;
+                if (AcceptToMemoryPoolWithTime(mempool, state, tx, true, NULL, nTime))
+                    ++nCount;
+                else
+                    ++nFailed;
+            } else {
+                ++nExpired;
+            }
+            if (ShutdownRequested())
+                return false;
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired in %dms\n",
+              nCount, nFailed, nExpired, GetTimeMillis() - nStart);
+    return true;
+}
+
 class CMainCleanup
 {
 public:
     CMainCleanup() {}
     ~CMainCleanup() {
-        // block headers
+        // block headers, the chain tip snapshot must not outlive them
+        boost::atomic_store(&pChainTipSnapshot, CChainTipSnapshotPtr(new CChainTipSnapshot()));
         BlockMap::iterator it1 = mapBlockIndex.begin();
         for (; it1 != mapBlockIndex.end(); it1++)
             delete (*it1).second;
@@ -30,6 +30,7 @@
 #include <utility>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
@@ -68,6 +69,8 @@ static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -154,6 +157,7 @@ extern unsigned int nBytesPerSigOp;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
+extern size_t nBlockServeCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
 extern bool fEnableReplacement;
@@ -179,6 +183,12 @@ static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
 static const signed int DEFAULT_CHECKBLOCKS = MIN_BLOCKS_TO_KEEP;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
 
+/** Default for -mappedblockfiles, number of finalized block and undo files kept mapped in memory */
+static const unsigned int DEFAULT_MAPPED_BLOCK_FILES = 64;
+
+/** Default for -blockservecache, MiB of serialized blocks kept for serving them to peers */
+static const unsigned int DEFAULT_BLOCK_SERVE_CACHE = 32;
+
 // Require that user allocate at least 550MB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
 // Add 15% for Undo data = 331MB
@@ -225,6 +235,8 @@ bool LoadBlockIndex();
 void UnloadBlockIndex();
 /** Process protocol messages received from a given node */
 bool ProcessMessages(CNode* pfrom);
+/** Process the masternode related messages at the front of a node's receive queue, on a message worker */
+bool ProcessWorkerMessages(CNode* pfrom);
 /**
  * Send queued protocol messages to be sent to a give node.
  *
@@ -233,6 +245,8 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof of work checking thread */
+void ThreadHeaderCheck();
 
 /** Try to detect Partition (network isolation) attacks against us */
 void PartitionCheck(bool (*initialDownloadCheck)(), CCriticalSection& cs, const CBlockIndex *const &bestHeader, int64_t nPowTargetSpacing);
@@ -292,6 +306,17 @@ void PruneAndFlush();
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
                         bool* pfMissingInputs, bool fOverrideMempoolLimit=false, bool fRejectAbsurdFee=false, bool fDryRun=false);
 
+/** (try to) add transaction to memory pool with a specified acceptance time **/
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
+                                bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit=false,
+                                bool fRejectAbsurdFee=false, bool fDryRun=false);
+
+/** Dump the mempool and its fee deltas to disk. */
+bool DumpMempool();
+
+/** Load the mempool dumped by DumpMempool() back through AcceptToMemoryPool. */
+bool LoadMempool();
+
 int GetUTXOHeight(const COutPoint& outpoint);
 int GetInputAge(const CTxIn &txin);
 int GetInputAgeIX(const uint256 &nTXHash, const CTxIn &txin);
@@ -583,6 +608,43 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/**
+ * Running totals of an address, kept next to the address index so its balance
+ * can be read without walking its whole history. Keyed by CAddressIndexIteratorKey.
+ */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    unsigned int txCount;
+    // last block included in the totals, so blocks connected again after an
+    // unclean shutdown or by -checklevel=4 are not counted twice
+    int nHeight;
+    uint256 hashBlock;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(VARINT(txCount));
+        READWRITE(nHeight);
+        READWRITE(hashBlock);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+        nHeight = -1;
+        hashBlock.SetNull();
+    }
+};
+
 struct CDiskTxPos : public CDiskBlockPos
 {
     unsigned int nTxOffset; // after header
@@ -713,18 +775,56 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing the proof of work check of a range of headers from a
+ * headers message. The hashes are written to phashes and memoized in the headers.
+ */
+class CHeaderPoWCheck
+{
+private:
+    const CBlockHeader *pheaders;
+    uint256 *phashes;
+    unsigned int nCount;
+
+public:
+    CHeaderPoWCheck(): pheaders(NULL), phashes(NULL), nCount(0) {}
+    CHeaderPoWCheck(const CBlockHeader* pheadersIn, uint256* phashesIn, unsigned int nCountIn) :
+        pheaders(pheadersIn), phashes(phashesIn), nCount(nCountIn) { }
+
+    bool operator()();
+
+    void swap(CHeaderPoWCheck &check) {
+        std::swap(pheaders, check.pheaders);
+        std::swap(phashes, check.phashes);
+        std::swap(nCount, check.nCount);
+    }
+};
+
+/**
+ * Context-free proof of work check of all headers of a headers message, run on
+ * the header check threads without holding cs_main. vHashesOut receives the hashes.
+ */
+bool CheckBlockHeadersPoW(const std::vector<CBlockHeader>& headers, std::vector<uint256>& vHashesOut, CValidationState& state);
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0,
+                     const CAddressIndexKey *pFrom = NULL, size_t nLimit = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentKey *pFrom = NULL, size_t nLimit = 0);
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Limit the number of block and undo files mapped for reading, 0 disables mapping */
+void SetMappedBlockFiles(unsigned int nFiles);
+/** Read the serialized block at pos as stored on disk, without deserializing or checking it */
+bool ReadRawBlockFromDisk(CDataStream& blockData, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -827,6 +927,38 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex *pindex);
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
+/**
+ * Immutable summary of the active chain tip. A new snapshot is published
+ * (under cs_main) every time chainActive's tip changes, so readers that only
+ * need the tip can take a copy of the pointer without locking cs_main.
+ * Block index entries are only freed by UnloadBlockIndex() and at shutdown,
+ * which publish an empty snapshot first, so pindex stays valid as long as the
+ * caller does not hold on to a snapshot across those (RPC is still in warmup
+ * then). Walking back from pindex with GetAncestor() is safe as pprev and
+ * pskip never change once set.
+ */
+struct CChainTipSnapshot
+{
+    const CBlockIndex* pindex;
+    int nHeight;
+    uint256 hashBlock;
+    arith_uint256 nChainWork;
+    int64_t nTime;
+    int64_t nMedianTimePast;
+
+    CChainTipSnapshot() : pindex(NULL), nHeight(-1), nTime(0), nMedianTimePast(0) {}
+    explicit CChainTipSnapshot(const CBlockIndex* pindexIn);
+
+    /** Whether pindexIn is part of the chain ending at this tip. */
+    bool Contains(const CBlockIndex* pindexIn) const;
+    /** The block at the given height in this chain, or NULL if out of range. */
+    const CBlockIndex* operator[](int nHeightIn) const;
+};
+typedef boost::shared_ptr<const CChainTipSnapshot> CChainTipSnapshotPtr;
+
+/** Return the most recently published chain tip snapshot (never NULL). */
+CChainTipSnapshotPtr GetChainTipSnapshot();
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
@@ -0,0 +1,95 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mappedfile.h"
+
+#include "compat.h"
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+CMappedFile::CMappedFile(const boost::filesystem::path& path) : pbegin(NULL), nSize(0)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            pbegin = static_cast<const char*>(p);
+            nSize = st.st_size;
+        } else {
+            LogPrintf("%s: mmap of %s failed: %s\n", __func__, path.string(), strerror(errno));
+        }
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    if (pbegin)
+        munmap(const_cast<char*>(pbegin), nSize);
+#endif
+}
+
+void CMappedFilePool::SetMaxFiles(unsigned int nMaxFilesIn)
+{
+    LOCK(cs);
+    nMaxFiles = nMaxFilesIn;
+    while (listFiles.size() > nMaxFiles) {
+        mapFiles.erase(listFiles.back().first);
+        listFiles.pop_back();
+    }
+}
+
+CMappedFilePool::file_ptr CMappedFilePool::Get(const boost::filesystem::path& path, size_t nMinSize)
+{
+    LOCK(cs);
+    if (nMaxFiles == 0)
+        return file_ptr();
+
+    const std::string strPath = path.string();
+    std::map<std::string, list_t::iterator>::iterator it = mapFiles.find(strPath);
+    if (it != mapFiles.end()) {
+        list_t::iterator itList = it->second;
+        if (itList->second->size() > nMinSize) {
+            listFiles.splice(listFiles.begin(), listFiles, itList);
+            return itList->second;
+        }
+        // the file grew, readers still using the old mapping keep it alive
+        listFiles.erase(itList);
+        mapFiles.erase(it);
+    }
+
+    file_ptr file(new CMappedFile(path));
+    if (file->IsNull() || file->size() <= nMinSize)
+        return file_ptr();
+
+    while (!listFiles.empty() && listFiles.size() >= nMaxFiles) {
+        mapFiles.erase(listFiles.back().first);
+        listFiles.pop_back();
+    }
+    listFiles.push_front(std::make_pair(strPath, file));
+    mapFiles[strPath] = listFiles.begin();
+    return file;
+}
+
+void CMappedFilePool::Erase(const boost::filesystem::path& path)
+{
+    LOCK(cs);
+    std::map<std::string, list_t::iterator>::iterator it = mapFiles.find(path.string());
+    if (it == mapFiles.end())
+        return;
+    listFiles.erase(it->second);
+    mapFiles.erase(it);
+}
@@ -0,0 +1,120 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "serialize.h"
+#include "sync.h"
+
+#include <ios>
+#include <list>
+#include <map>
+#include <string.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+/** A file mapped read-only into memory. The mapping is empty if the file
+ *  could not be mapped, e.g. on platforms without mmap.
+ */
+class CMappedFile : private boost::noncopyable
+{
+private:
+    const char* pbegin;
+    size_t nSize;
+
+public:
+    explicit CMappedFile(const boost::filesystem::path& path);
+    ~CMappedFile();
+
+    bool IsNull() const { return pbegin == NULL; }
+    const char* begin() const { return pbegin; }
+    size_t size() const { return nSize; }
+};
+
+/** Read-only stream over a mapped file, a drop-in for CAutoFile when
+ *  deserializing. Reads are memcpy's from the mapping, no syscalls involved.
+ */
+class CMappedFileStream
+{
+private:
+    //! Keeps the mapping alive while the stream is used
+    boost::shared_ptr<const CMappedFile> file;
+    size_t nPos;
+
+    int nType;
+    int nVersion;
+
+public:
+    CMappedFileStream(const boost::shared_ptr<const CMappedFile>& fileIn, size_t nPosIn, int nTypeIn, int nVersionIn) :
+        file(fileIn), nPos(nPosIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    //
+    // Stream subset
+    //
+    void SetType(int n)          { nType = n; }
+    int GetType()                { return nType; }
+    void SetVersion(int n)       { nVersion = n; }
+    int GetVersion()             { return nVersion; }
+
+    size_t GetPos() const        { return nPos; }
+
+    CMappedFileStream& read(char* pch, size_t nSize)
+    {
+        if (nPos > file->size() || nSize > file->size() - nPos)
+            throw std::ios_base::failure("CMappedFileStream::read: end of data");
+        memcpy(pch, file->begin() + nPos, nSize);
+        nPos += nSize;
+        return (*this);
+    }
+
+    CMappedFileStream& ignore(size_t nSize)
+    {
+        if (nPos > file->size() || nSize > file->size() - nPos)
+            throw std::ios_base::failure("CMappedFileStream::ignore: end of data");
+        nPos += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    CMappedFileStream& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Recently used file mappings, at most nMaxFiles of them */
+class CMappedFilePool
+{
+private:
+    typedef boost::shared_ptr<const CMappedFile> file_ptr;
+    typedef std::list<std::pair<std::string, file_ptr> > list_t;
+
+    CCriticalSection cs;
+    //! Most recently used first
+    list_t listFiles;
+    std::map<std::string, list_t::iterator> mapFiles;
+    unsigned int nMaxFiles;
+
+public:
+    CMappedFilePool() : nMaxFiles(0) {}
+
+    void SetMaxFiles(unsigned int nMaxFilesIn);
+
+    /**
+     * Return the mapping of the file, which must extend beyond nMinSize.
+     * Files which grew since they were mapped are mapped again. Returns an
+     * empty pointer if the pool is disabled or the file can't be mapped.
+     */
+    file_ptr Get(const boost::filesystem::path& path, size_t nMinSize);
+
+    /** Forget the mapping of a file, e.g. before it is deleted */
+    void Erase(const boost::filesystem::path& path);
+};
+
+#endif // MAPPEDFILE_H
@@ -17,6 +17,7 @@
 
 /** Object for who's going to get paid on which blocks */
 CMasternodePayments mnpayments;
+CCoinbasePayeeIndex coinbasePayees;
 
 CCriticalSection cs_vecPayees;
 CCriticalSection cs_mapMasternodeBlocks;
@@ -415,12 +416,17 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand,
     }
 }
 
+std::string CMasternodePaymentVote::GetSignatureMessage() const
+{
+    return vinMasternode.prevout.ToStringShort() +
+            boost::lexical_cast<std::string>(nBlockHeight) +
+            ScriptToAsmStr(payee);
+}
+
 bool CMasternodePaymentVote::Sign()
 {
     std::string strError;
-    std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                boost::lexical_cast<std::string>(nBlockHeight) +
-                ScriptToAsmStr(payee);
+    std::string strMessage = GetSignatureMessage();
 
     if(!darkSendSigner.SignMessage(strMessage, vchSig, activeMasternode.keyMasternode)) {
         LogPrintf("CMasternodePaymentVote::Sign -- SignMessage() failed\n");
@@ -789,9 +795,7 @@ bool CMasternodePaymentVote::CheckSignature(const CPubKey& pubKeyMasternode, int
     // do not ban by default
     nDos = 0;
 
-    std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                boost::lexical_cast<std::string>(nBlockHeight) +
-                ScriptToAsmStr(payee);
+    std::string strMessage = GetSignatureMessage();
 
     std::string strError = "";
     if (!darkSendSigner.VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
@@ -952,5 +956,86 @@ void CMasternodePayments::UpdatedBlockTip(const CBlockIndex *pindex)
     pCurrentBlockIndex = pindex;
     LogPrint("mnpayments", "CMasternodePayments::UpdatedBlockTip -- pCurrentBlockIndex->nHeight=%d\n", pCurrentBlockIndex->nHeight);
 
+    coinbasePayees.SetBlocksToKeep(GetStorageLimit());
+
     ProcessBlock(pindex->nHeight + 10);
 }
+
+void CCoinbasePayeeIndex::AddBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    const CTransaction& txCoinbase = block.vtx[0];
+    CAmount nMasternodePayment = GetMasternodePayment(pindex->nHeight, txCoinbase.GetValueOut());
+
+    payees_t payees;
+    payees.blockHash = pindex->GetBlockHash();
+    BOOST_FOREACH(const CTxOut& txout, txCoinbase.vout) {
+        if(txout.nValue == nMasternodePayment)
+            payees.vecPayees.push_back(txout.scriptPubKey);
+    }
+
+    LOCK(cs);
+    mapPayees[pindex->nHeight] = payees;
+
+    // drop blocks which are too deep to matter for last paid tracking
+    int nFirstHeight = pindex->nHeight - nBlocksToKeep;
+    std::map<int, payees_t>::iterator it = mapPayees.begin();
+    while(it != mapPayees.end() && it->first < nFirstHeight) {
+        mapPayees.erase(it++);
+    }
+}
+
+void CCoinbasePayeeIndex::RemoveBlock(const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    std::map<int, payees_t>::iterator it = mapPayees.find(pindex->nHeight);
+    if(it != mapPayees.end() && it->second.blockHash == pindex->GetBlockHash())
+        mapPayees.erase(it);
+}
+
+void CCoinbasePayeeIndex::LoadFromChain(const CBlockIndex* pindexTip, int nBlocks)
+{
+    int64_t nTimeStart = GetTimeMillis();
+    int nLoaded = 0;
+
+    for(const CBlockIndex* pindex = pindexTip; pindex && nLoaded < nBlocks; pindex = pindex->pprev, nLoaded++) {
+        if(!(pindex->nStatus & BLOCK_HAVE_DATA)) break; // pruned
+        {
+            LOCK(cs);
+            std::map<int, payees_t>::iterator it = mapPayees.find(pindex->nHeight);
+            if(it != mapPayees.end() && it->second.blockHash == pindex->GetBlockHash()) continue;
+        }
+        CBlock block;
+        if(!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            LogPrintf("CCoinbasePayeeIndex::LoadFromChain -- failed to read block %s\n", pindex->GetBlockHash().ToString());
+            break;
+        }
+        AddBlock(block, pindex);
+    }
+
+    LogPrintf("CCoinbasePayeeIndex::LoadFromChain -- loaded %d blocks in %dms\n", nLoaded, GetTimeMillis() - nTimeStart);
+}
+
+bool CCoinbasePayeeIndex::HasPayee(const CBlockIndex* pindex, const CScript& payee) const
+{
+    LOCK(cs);
+    std::map<int, payees_t>::const_iterator it = mapPayees.find(pindex->nHeight);
+    if(it == mapPayees.end() || it->second.blockHash != pindex->GetBlockHash())
+        return false;
+
+    BOOST_FOREACH(const CScript& script, it->second.vecPayees) {
+        if(script == payee) return true;
+    }
+    return false;
+}
+
+void CCoinbasePayeeIndex::SetBlocksToKeep(int nBlocks)
+{
+    LOCK(cs);
+    nBlocksToKeep = nBlocks;
+}
+
+int CCoinbasePayeeIndex::size() const
+{
+    LOCK(cs);
+    return mapPayees.size();
+}
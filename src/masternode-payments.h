@@ -13,6 +13,7 @@
 #include "masternode.h"
 #include "utilstrencodings.h"
 
+class CCoinbasePayeeIndex;
 class CMasternodePayments;
 class CMasternodePaymentVote;
 class CMasternodeBlockPayees;
@@ -29,9 +30,10 @@ static const int MIN_MASTERNODE_PAYMENT_PROTO_VERSION_2 = 70208;
 
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapMasternodeBlocks;
-extern CCriticalSection cs_mapMasternodePayeeVotes;
+extern CCriticalSection cs_mapMasternodePaymentVotes;
 
 extern CMasternodePayments mnpayments;
+extern CCoinbasePayeeIndex coinbasePayees;
 
 /// TODO: all 4 functions do not belong here really, they should be refactored/moved somewhere (main.cpp ?)
 bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockReward, std::string &strErrorRet);
@@ -148,6 +150,7 @@ public:
         return ss.GetHash();
     }
 
+    std::string GetSignatureMessage() const;
     bool Sign();
     bool CheckSignature(const CPubKey& pubKeyMasternode, int nValidationHeight, int &nDos);
 
@@ -160,6 +163,49 @@ public:
     std::string ToString() const;
 };
 
+//
+// Coinbase Payee Index
+// Keeps the masternode payment outputs of recent active chain blocks in memory
+// so that last paid blocks can be found without reading blocks from disk
+//
+
+class CCoinbasePayeeIndex
+{
+private:
+    // blocks below tip height minus this are dropped
+    static const int DEFAULT_BLOCKS_TO_KEEP = 5000;
+
+    struct payees_t {
+        uint256 blockHash;
+        // coinbase outputs paying exactly the masternode payment for this height
+        std::vector<CScript> vecPayees;
+    };
+
+    mutable CCriticalSection cs;
+    std::map<int, payees_t> mapPayees;
+    int nBlocksToKeep;
+
+public:
+    CCoinbasePayeeIndex() : mapPayees(), nBlocksToKeep(DEFAULT_BLOCKS_TO_KEEP) {}
+
+    /// Index the coinbase of a block connected to the active chain
+    void AddBlock(const CBlock& block, const CBlockIndex* pindex);
+    /// Forget a block disconnected from the active chain
+    void RemoveBlock(const CBlockIndex* pindex);
+    /// Read the last nBlocks blocks of the chain ending at pindexTip from disk,
+    /// used once at startup for blocks connected in previous sessions
+    void LoadFromChain(const CBlockIndex* pindexTip, int nBlocks);
+
+    /**
+     * Whether the block at pindex paid the masternode payment to payee.
+     * Returns false if the block is not (or no longer) indexed.
+     */
+    bool HasPayee(const CBlockIndex* pindex, const CScript& payee) const;
+
+    void SetBlocksToKeep(int nBlocks);
+    int size() const;
+};
+
 //
 // Masternode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -187,6 +233,7 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
         READWRITE(mapMasternodePaymentVotes);
         READWRITE(mapMasternodeBlocks);
     }
@@ -79,6 +79,7 @@ public:
 
     bool IsExpired() { return GetTime() - sigTime > MASTERNODE_NEW_START_REQUIRED_SECONDS; }
 
+    std::string GetSignatureMessage() const;
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool CheckSignature(CPubKey& pubKeyMasternode, int &nDos);
     bool SimpleCheck(int& nDos);
@@ -381,6 +382,7 @@ public:
     bool Update(CMasternode* pmn, int& nDos);
     bool CheckOutpoint(int& nDos);
 
+    std::string GetSignatureMessage() const;
     bool Sign(CKey& keyCollateralAddress);
     bool CheckSignature(int& nDos);
     void Relay();
@@ -441,6 +443,19 @@ public:
         return ss.GetHash();
     }
 
+    /// Message signed by the verified masternode, blockHash is the hash of the block at nBlockHeight
+    std::string GetSignatureMessage1(const uint256& blockHash) const
+    {
+        return strprintf("%s%d%s", addr.ToString(false), nonce, blockHash.ToString());
+    }
+
+    /// Message signed by the verifying masternode
+    std::string GetSignatureMessage2(const uint256& blockHash) const
+    {
+        return strprintf("%s%d%s%s%s", addr.ToString(false), nonce, blockHash.ToString(),
+                            vin1.prevout.ToStringShort(), vin2.prevout.ToStringShort());
+    }
+
     void Relay() const
     {
         CInv inv(MSG_MASTERNODE_VERIFY, GetHash());
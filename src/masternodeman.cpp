@@ -11,8 +11,12 @@
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "netfulfilledman.h"
+#include "random.h"
 #include "util.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 /** Masternode manager */
 CMasternodeMan mnodeman;
 
@@ -36,6 +40,8 @@ struct CompareScoreMN
     }
 };
 
+CMasternodeKeyHasher::CMasternodeKeyHasher() : salt(GetRandHash()) {}
+
 CMasternodeIndex::CMasternodeIndex()
     : nSize(0),
       mapIndex(),
@@ -99,7 +105,10 @@ void CMasternodeIndex::RebuildIndex()
 
 CMasternodeMan::CMasternodeMan()
 : cs(),
-  vMasternodes(),
+  listMasternodes(),
+  mapMasternodesByOutpoint(),
+  mapMasternodesByPubKey(),
+  mapMasternodesByPayee(),
   mAskedUsForMasternodeList(),
   mWeAskedForMasternodeList(),
   mWeAskedForMasternodeListEntry(),
@@ -127,8 +136,10 @@ bool CMasternodeMan::Add(CMasternode &mn)
     CMasternode *pmn = Find(mn.vin);
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
-        vMasternodes.push_back(mn);
+        listMasternodes.push_back(mn);
+        AddToLookupIndexes(&listMasternodes.back());
         indexMasternodes.AddMasternodeVIN(mn.vin);
+        ClearRankCache();
         fMasternodesAdded = true;
         return true;
     }
@@ -171,7 +182,7 @@ void CMasternodeMan::Check()
 
     LogPrint("masternode", "CMasternodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
         mn.Check();
     }
 }
@@ -190,11 +201,11 @@ void CMasternodeMan::CheckAndRemove()
         Check();
 
         // Remove spent masternodes, prepare structures and make requests to reasure the state of inactive ones
-        std::vector<CMasternode>::iterator it = vMasternodes.begin();
+        std::list<CMasternode>::iterator it = listMasternodes.begin();
         std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES masternode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
-        while(it != vMasternodes.end()) {
+        while(it != listMasternodes.end()) {
             CMasternodeBroadcast mnb = CMasternodeBroadcast(*it);
             uint256 hash = mnb.GetHash();
             // If collateral was spent ...
@@ -207,7 +218,9 @@ void CMasternodeMan::CheckAndRemove()
 
                 // and finally remove it from the list
                 it->FlagGovernanceItemsAsDirty();
-                it = vMasternodes.erase(it);
+                RemoveFromLookupIndexes(&(*it));
+                it = listMasternodes.erase(it);
+                ClearRankCache();
                 fMasternodesRemoved = true;
             } else {
                 bool fAsk = pCurrentBlockIndex &&
@@ -367,7 +380,10 @@ void CMasternodeMan::CheckAndRemove()
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
-    vMasternodes.clear();
+    listMasternodes.clear();
+    mapMasternodesByOutpoint.clear();
+    mapMasternodesByPubKey.clear();
+    mapMasternodesByPayee.clear();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -377,6 +393,7 @@ void CMasternodeMan::Clear()
     nLastWatchdogVoteTime = 0;
     indexMasternodes.Clear();
     indexMasternodesOld.Clear();
+    ClearRankCache();
 }
 
 int CMasternodeMan::CountMasternodes(int nProtocolVersion)
@@ -385,7 +402,7 @@ int CMasternodeMan::CountMasternodes(int nProtocolVersion)
     int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinMasternodePaymentsProto() : nProtocolVersion;
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
         if(mn.nProtocolVersion < nProtocolVersion) continue;
         nCount++;
     }
@@ -399,7 +416,7 @@ int CMasternodeMan::CountEnabled(int nProtocolVersion)
     int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinMasternodePaymentsProto() : nProtocolVersion;
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
         if(mn.nProtocolVersion < nProtocolVersion || !mn.IsEnabled()) continue;
         nCount++;
     }
@@ -413,7 +430,7 @@ int CMasternodeMan::CountByIP(int nNetworkType)
     LOCK(cs);
     int nNodeCount = 0;
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
+    BOOST_FOREACH(CMasternode& mn, listMasternodes)
         if ((nNetworkType == NET_IPV4 && mn.addr.IsIPv4()) ||
             (nNetworkType == NET_TOR  && mn.addr.IsTor())  ||
             (nNetworkType == NET_IPV6 && mn.addr.IsIPv6())) {
@@ -445,14 +462,71 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
     LogPrint("masternode", "CMasternodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
+static uint256 GetPayeeIndexKey(const CScript& payee)
+{
+    return Hash(payee.begin(), payee.end());
+}
+
+void CMasternodeMan::AddToLookupIndexes(CMasternode* pmn)
+{
+    mapMasternodesByOutpoint[pmn->vin.prevout] = pmn;
+    mapMasternodesByPubKey.insert(std::make_pair(pmn->pubKeyMasternode.GetHash(), pmn));
+    mapMasternodesByPayee.insert(std::make_pair(GetPayeeIndexKey(GetScriptForDestination(pmn->pubKeyCollateralAddress.GetID())), pmn));
+}
+
+template <typename Multimap>
+static void EraseFromMultimap(Multimap& map, const uint256& key, const CMasternode* pmn)
+{
+    std::pair<typename Multimap::iterator, typename Multimap::iterator> range = map.equal_range(key);
+    for(typename Multimap::iterator it = range.first; it != range.second; ++it) {
+        if(it->second == pmn) {
+            map.erase(it);
+            return;
+        }
+    }
+}
+
+void CMasternodeMan::RemoveFromLookupIndexes(CMasternode* pmn)
+{
+    mapMasternodesByOutpoint.erase(pmn->vin.prevout);
+    EraseFromMultimap(mapMasternodesByPubKey, pmn->pubKeyMasternode.GetHash(), pmn);
+    EraseFromMultimap(mapMasternodesByPayee, GetPayeeIndexKey(GetScriptForDestination(pmn->pubKeyCollateralAddress.GetID())), pmn);
+}
+
+void CMasternodeMan::RebuildLookupIndexes()
+{
+    mapMasternodesByOutpoint.clear();
+    mapMasternodesByPubKey.clear();
+    mapMasternodesByPayee.clear();
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
+        AddToLookupIndexes(&mn);
+    }
+    ClearRankCache();
+}
+
+void CMasternodeMan::UpdateMasternodePubKey(CMasternode* pmn, const CPubKey& pubKeyMasternodeOld)
+{
+    LOCK(cs);
+
+    // only entries owned by the list are indexed
+    boost::unordered_map<COutPoint, CMasternode*, CMasternodeKeyHasher>::iterator it = mapMasternodesByOutpoint.find(pmn->vin.prevout);
+    if(it == mapMasternodesByOutpoint.end() || it->second != pmn) return;
+
+    EraseFromMultimap(mapMasternodesByPubKey, pubKeyMasternodeOld.GetHash(), pmn);
+    mapMasternodesByPubKey.insert(std::make_pair(pmn->pubKeyMasternode.GetHash(), pmn));
+}
+
 CMasternode* CMasternodeMan::Find(const CScript &payee)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
-            return &mn;
+    std::pair<boost::unordered_multimap<uint256, CMasternode*, CMasternodeKeyHasher>::iterator,
+              boost::unordered_multimap<uint256, CMasternode*, CMasternodeKeyHasher>::iterator> range =
+        mapMasternodesByPayee.equal_range(GetPayeeIndexKey(payee));
+    for(; range.first != range.second; ++range.first) {
+        CMasternode* pmn = range.first->second;
+        if(GetScriptForDestination(pmn->pubKeyCollateralAddress.GetID()) == payee)
+            return pmn;
     }
     return NULL;
 }
@@ -461,22 +535,22 @@ CMasternode* CMasternodeMan::Find(const CTxIn &vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_map<COutPoint, CMasternode*, CMasternodeKeyHasher>::iterator it = mapMasternodesByOutpoint.find(vin.prevout);
+    if(it == mapMasternodesByOutpoint.end())
+        return NULL;
+    return it->second;
 }
 
 CMasternode* CMasternodeMan::Find(const CPubKey &pubKeyMasternode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.pubKeyMasternode == pubKeyMasternode)
-            return &mn;
+    std::pair<boost::unordered_multimap<uint256, CMasternode*, CMasternodeKeyHasher>::iterator,
+              boost::unordered_multimap<uint256, CMasternode*, CMasternodeKeyHasher>::iterator> range =
+        mapMasternodesByPubKey.equal_range(pubKeyMasternode.GetHash());
+    for(; range.first != range.second; ++range.first) {
+        if(range.first->second->pubKeyMasternode == pubKeyMasternode)
+            return range.first->second;
     }
     return NULL;
 }
@@ -561,7 +635,7 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     */
 
     int nMnCount = CountEnabled();
-    BOOST_FOREACH(CMasternode &mn, vMasternodes)
+    BOOST_FOREACH(CMasternode &mn, listMasternodes)
     {
         if(!mn.IsValidForPayment()) continue;
 
@@ -600,8 +674,12 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     int nTenthNetwork = nMnCount/10;
     int nCountTenth = 0;
     arith_uint256 nHighest = 0;
+    const rank_table_t& rankTable = GetRankTable(blockHash);
     BOOST_FOREACH (PAIRTYPE(int, CMasternode*)& s, vecMasternodeLastPaid){
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
+        std::map<COutPoint, std::pair<arith_uint256, int> >::const_iterator it = rankTable.mapPositions.find(s.second->vin.prevout);
+        // not in the rank table, nothing to compare
+        if(it == rankTable.mapPositions.end()) continue;
+        arith_uint256 nScore = it->second.first;
         if(nScore > nHighest){
             nHighest = nScore;
             pBestMasternode = s.second;
@@ -626,7 +704,7 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToE
 
     // fill a vector of pointers
     std::vector<CMasternode*> vpMasternodesShuffled;
-    BOOST_FOREACH(CMasternode &mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode &mn, listMasternodes) {
         vpMasternodesShuffled.push_back(&mn);
     }
 
@@ -655,36 +733,102 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToE
     return NULL;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+static void CalculateScoresRange(const std::vector<CMasternode*>& vpMasternodes, const uint256& blockHash,
+                                 std::vector<arith_uint256>& vecScoresOut, size_t nBegin, size_t nEnd)
+{
+    for(size_t i = nBegin; i < nEnd; i++) {
+        vecScoresOut[i] = vpMasternodes[i]->CalculateScore(blockHash);
+    }
+}
+
+const CMasternodeMan::rank_table_t& CMasternodeMan::GetRankTable(const uint256& blockHash)
+{
+    AssertLockHeld(cs);
+
+    std::map<uint256, rank_table_t>::iterator it = mapRankCache.find(blockHash);
+    if(it != mapRankCache.end()) {
+        return it->second;
+    }
+
+    std::vector<CMasternode*> vpMasternodes;
+    vpMasternodes.reserve(listMasternodes.size());
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
+        vpMasternodes.push_back(&mn);
+    }
+
+    // Scoring takes two hashes per masternode, split large lists between threads
+    std::vector<arith_uint256> vecFullScores(vpMasternodes.size());
+    int nThreads = std::min(GetNumCores(), (int)vpMasternodes.size() / RANK_CACHE_PARALLEL_THRESHOLD);
+    if(nThreads > 1) {
+        boost::thread_group threadGroup;
+        size_t nChunk = (vpMasternodes.size() + nThreads - 1) / nThreads;
+        for(size_t nBegin = 0; nBegin < vpMasternodes.size(); nBegin += nChunk) {
+            size_t nEnd = std::min(nBegin + nChunk, vpMasternodes.size());
+            threadGroup.create_thread(boost::bind(&CalculateScoresRange, boost::cref(vpMasternodes), boost::cref(blockHash),
+                                                  boost::ref(vecFullScores), nBegin, nEnd));
+        }
+        threadGroup.join_all();
+    } else {
+        CalculateScoresRange(vpMasternodes, blockHash, vecFullScores, 0, vpMasternodes.size());
+    }
+
+    if((int)mapRankCache.size() >= MAX_RANK_CACHE_ENTRIES) {
+        mapRankCache.erase(listRankCacheOrder.front());
+        listRankCacheOrder.pop_front();
+    }
+    rank_table_t& rankTable = mapRankCache[blockHash];
+    listRankCacheOrder.push_back(blockHash);
+
+    std::map<CMasternode*, arith_uint256> mapFullScores;
+    rankTable.vecScores.reserve(vpMasternodes.size());
+    for(size_t i = 0; i < vpMasternodes.size(); i++) {
+        rankTable.vecScores.push_back(std::make_pair(vecFullScores[i].GetCompact(false), vpMasternodes[i]));
+        mapFullScores[vpMasternodes[i]] = vecFullScores[i];
+    }
+    sort(rankTable.vecScores.rbegin(), rankTable.vecScores.rend(), CompareScoreMN());
+
+    for(size_t i = 0; i < rankTable.vecScores.size(); i++) {
+        CMasternode* pmn = rankTable.vecScores[i].second;
+        rankTable.mapPositions[pmn->vin.prevout] = std::make_pair(mapFullScores[pmn], (int)i);
+    }
+
+    LogPrint("masternode", "CMasternodeMan::GetRankTable -- scored %d masternodes for block %s\n", (int)vpMasternodes.size(), blockHash.ToString());
+
+    return rankTable;
+}
+
+void CMasternodeMan::ClearRankCache()
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
+    mapRankCache.clear();
+    listRankCacheOrder.clear();
+}
 
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+{
     //make sure we know about this block
     uint256 blockHash = uint256();
     if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        if(mn.nProtocolVersion < nMinProtocol) continue;
+    const rank_table_t& rankTable = GetRankTable(blockHash);
+    std::map<COutPoint, std::pair<arith_uint256, int> >::const_iterator it = rankTable.mapPositions.find(vin.prevout);
+    if(it == rankTable.mapPositions.end()) return -1;
+
+    // masternode states change between calls, so only those ranked above
+    // this one need to be filtered
+    int nRank = 0;
+    for(int i = 0; i <= it->second.second; i++) {
+        CMasternode* pmn = rankTable.vecScores[i].second;
+        if(pmn->nProtocolVersion < nMinProtocol) continue;
         if(fOnlyActive) {
-            if(!mn.IsEnabled()) continue;
+            if(!pmn->IsEnabled()) continue;
         }
         else {
-            if(!mn.IsValidForPayment()) continue;
+            if(!pmn->IsValidForPayment()) continue;
         }
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
-
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& scorePair, vecMasternodeScores) {
         nRank++;
-        if(scorePair.second->vin.prevout == vin.prevout) return nRank;
+        if(i == it->second.second) return nRank;
     }
 
     return -1;
@@ -692,7 +836,6 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nM
 
 std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int nBlockHeight, int nMinProtocol)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
     std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
 
     //make sure we know about this block
@@ -701,20 +844,11 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
+    const rank_table_t& rankTable = GetRankTable(blockHash);
 
     int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores) {
+    BOOST_FOREACH (const PAIRTYPE(int64_t, CMasternode*)& s, rankTable.vecScores) {
+        if(s.second->nProtocolVersion < nMinProtocol || !s.second->IsEnabled()) continue;
         nRank++;
         vecMasternodeRanks.push_back(std::make_pair(nRank, *s.second));
     }
@@ -724,8 +858,6 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
-
     LOCK(cs);
 
     uint256 blockHash;
@@ -734,21 +866,12 @@ CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int nBlockHeight, in
         return NULL;
     }
 
-    // Fill scores
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive && !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
+    const rank_table_t& rankTable = GetRankTable(blockHash);
 
     int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores){
+    BOOST_FOREACH (const PAIRTYPE(int64_t, CMasternode*)& s, rankTable.vecScores){
+        if(s.second->nProtocolVersion < nMinProtocol) continue;
+        if(fOnlyActive && !s.second->IsEnabled()) continue;
         rank++;
         if(rank == nRank) {
             return s.second;
@@ -901,7 +1024,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         int nInvCount = 0;
 
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        BOOST_FOREACH(CMasternode& mn, listMasternodes) {
             if (vin != CTxIn() && vin != mn.vin) continue; // asked for specific vin but we are not there yet
             if (mn.addr.IsRFC1918() || mn.addr.IsLocal()) continue; // do not send local network masternode
             if (mn.IsUpdateRequired()) continue; // do not send outdated masternodes
@@ -996,7 +1119,7 @@ void CMasternodeMan::DoFullVerificationStep()
     if(nOffset >= (int)vecMasternodeRanks.size()) return;
 
     std::vector<CMasternode*> vSortedByAddr;
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
         vSortedByAddr.push_back(&mn);
     }
 
@@ -1036,7 +1159,7 @@ void CMasternodeMan::DoFullVerificationStep()
 
 void CMasternodeMan::CheckSameAddr()
 {
-    if(!masternodeSync.IsSynced() || vMasternodes.empty()) return;
+    if(!masternodeSync.IsSynced() || listMasternodes.empty()) return;
 
     std::vector<CMasternode*> vBan;
     std::vector<CMasternode*> vSortedByAddr;
@@ -1047,7 +1170,7 @@ void CMasternodeMan::CheckSameAddr()
         CMasternode* pprevMasternode = NULL;
         CMasternode* pverifiedMasternode = NULL;
 
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        BOOST_FOREACH(CMasternode& mn, listMasternodes) {
             vSortedByAddr.push_back(&mn);
         }
 
@@ -1197,9 +1320,9 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
 
         CMasternode* prealMasternode = NULL;
         std::vector<CMasternode*> vpMasternodesToBan;
-        std::vector<CMasternode>::iterator it = vMasternodes.begin();
+        std::list<CMasternode>::iterator it = listMasternodes.begin();
         std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(false), mnv.nonce, blockHash.ToString());
-        while(it != vMasternodes.end()) {
+        while(it != listMasternodes.end()) {
             if((CAddress)it->addr == pnode->addr) {
                 if(darkSendSigner.VerifyMessage(it->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
                     // found it!
@@ -1310,9 +1433,8 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
     {
         LOCK(cs);
 
-        std::string strMessage1 = strprintf("%s%d%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString());
-        std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
-                                mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+        std::string strMessage1 = mnv.GetSignatureMessage1(blockHash);
+        std::string strMessage2 = mnv.GetSignatureMessage2(blockHash);
 
         CMasternode* pmn1 = Find(mnv.vin1);
         if(!pmn1) {
@@ -1351,7 +1473,7 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
 
         // increase ban score for everyone else with the same addr
         int nCount = 0;
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        BOOST_FOREACH(CMasternode& mn, listMasternodes) {
             if(mn.addr != mnv.addr || mn.vin.prevout == mnv.vin1.prevout) continue;
             mn.IncreasePoSeBanScore();
             nCount++;
@@ -1367,7 +1489,7 @@ std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Masternodes: " << (int)vMasternodes.size() <<
+    info << "Masternodes: " << (int)listMasternodes.size() <<
             ", peers who asked us for Masternode list: " << (int)mAskedUsForMasternodeList.size() <<
             ", peers we asked for Masternode list: " << (int)mWeAskedForMasternodeList.size() <<
             ", entries in Masternode list we asked for: " << (int)mWeAskedForMasternodeListEntry.size() <<
@@ -1504,7 +1626,7 @@ void CMasternodeMan::UpdateLastPaid()
     // LogPrint("mnpayments", "CMasternodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
     //                         pCurrentBlockIndex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
         mn.UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
     }
 
@@ -1524,14 +1646,14 @@ void CMasternodeMan::CheckAndRebuildMasternodeIndex()
         return;
     }
 
-    if(indexMasternodes.GetSize() <= int(vMasternodes.size())) {
+    if(indexMasternodes.GetSize() <= int(listMasternodes.size())) {
         return;
     }
 
     indexMasternodesOld = indexMasternodes;
     indexMasternodes.Clear();
-    for(size_t i = 0; i < vMasternodes.size(); ++i) {
-        indexMasternodes.AddMasternodeVIN(vMasternodes[i].vin);
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
+        indexMasternodes.AddMasternodeVIN(mn.vin);
     }
 
     fIndexRebuilt = true;
@@ -1570,7 +1692,7 @@ bool CMasternodeMan::AddGovernanceVote(const CTxIn& vin, uint256 nGovernanceObje
 void CMasternodeMan::RemoveGovernanceObject(uint256 nGovernanceObjectHash)
 {
     LOCK(cs);
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
         mn.RemoveGovernanceObject(nGovernanceObjectHash);
     }
 }
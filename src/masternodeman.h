@@ -9,6 +9,8 @@
 #include "masternode.h"
 #include "sync.h"
 
+#include <boost/unordered_map.hpp>
+
 using namespace std;
 
 class CMasternodeMan;
@@ -79,6 +81,24 @@ private:
 
 };
 
+/** Salted hasher for the masternode lookup indexes, see CCoinsKeyHasher */
+class CMasternodeKeyHasher
+{
+private:
+    uint256 salt;
+
+public:
+    CMasternodeKeyHasher();
+
+    size_t operator()(const uint256& key) const {
+        return key.GetHash(salt);
+    }
+
+    size_t operator()(const COutPoint& outpoint) const {
+        return outpoint.hash.GetHash(salt) ^ outpoint.n;
+    }
+};
+
 class CMasternodeMan
 {
 public:
@@ -111,6 +131,23 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    /// Number of block hashes to keep score tables for
+    static const int MAX_RANK_CACHE_ENTRIES         = 32;
+    /// Score larger lists on several threads
+    static const int RANK_CACHE_PARALLEL_THRESHOLD  = 1000;
+
+    /**
+     * Masternodes sorted by score for a given block hash, best first.
+     * Holds pointers into listMasternodes, so it must be dropped whenever
+     * masternodes are added or removed.
+     */
+    struct rank_table_t {
+        /// Compact score and masternode, in rank order
+        std::vector<std::pair<int64_t, CMasternode*> > vecScores;
+        /// Full score and position in vecScores by collateral outpoint
+        std::map<COutPoint, std::pair<arith_uint256, int> > mapPositions;
+    };
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -118,8 +155,13 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
-    // map to hold all MNs
-    std::vector<CMasternode> vMasternodes;
+    // list to hold all MNs, entries never move so pointers stay valid until removal
+    std::list<CMasternode> listMasternodes;
+    // lookup indexes into listMasternodes by collateral outpoint, by
+    // hash of pubKeyMasternode and by hash of the payee script
+    boost::unordered_map<COutPoint, CMasternode*, CMasternodeKeyHasher> mapMasternodesByOutpoint;
+    boost::unordered_multimap<uint256, CMasternode*, CMasternodeKeyHasher> mapMasternodesByPubKey;
+    boost::unordered_multimap<uint256, CMasternode*, CMasternodeKeyHasher> mapMasternodesByPayee;
     // who's asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
     // who we asked for the Masternode list and the last time
@@ -153,8 +195,21 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // score tables by block hash, and the order they were built in for eviction
+    std::map<uint256, rank_table_t> mapRankCache;
+    std::list<uint256> listRankCacheOrder;
+
     friend class CMasternodeSync;
 
+    /// Score table for blockHash, built on first use. Requires cs.
+    const rank_table_t& GetRankTable(const uint256& blockHash);
+    /// Drop all score tables, must be called whenever masternodes are added or removed
+    void ClearRankCache();
+
+    void AddToLookupIndexes(CMasternode* pmn);
+    void RemoveFromLookupIndexes(CMasternode* pmn);
+    void RebuildLookupIndexes();
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> > mapSeenMasternodeBroadcast;
@@ -180,7 +235,16 @@ public:
             READWRITE(strVersion);
         }
 
-        READWRITE(vMasternodes);
+        // stored as a vector for mncache.dat compatibility
+        std::vector<CMasternode> vecMasternodes;
+        if(!ser_action.ForRead()) {
+            vecMasternodes.assign(listMasternodes.begin(), listMasternodes.end());
+        }
+        READWRITE(vecMasternodes);
+        if(ser_action.ForRead()) {
+            listMasternodes.assign(vecMasternodes.begin(), vecMasternodes.end());
+            RebuildLookupIndexes();
+        }
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
         READWRITE(mWeAskedForMasternodeListEntry);
@@ -192,6 +256,9 @@ public:
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
         READWRITE(indexMasternodes);
+        if(ser_action.ForRead()) {
+            ClearRankCache();
+        }
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
@@ -293,7 +360,10 @@ public:
     /// Find a random entry
     CMasternode* FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion = -1);
 
-    std::vector<CMasternode> GetFullMasternodeVector() { return vMasternodes; }
+    std::vector<CMasternode> GetFullMasternodeVector() {
+        LOCK(cs);
+        return std::vector<CMasternode>(listMasternodes.begin(), listMasternodes.end());
+    }
 
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
     int GetMasternodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
@@ -312,7 +382,7 @@ public:
     void ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerification& mnv);
 
     /// Return the number of (unique) Masternodes
-    int size() { return vMasternodes.size(); }
+    int size() { return listMasternodes.size(); }
 
     std::string ToString() const;
 
@@ -322,6 +392,9 @@ public:
     bool CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
 
+    bool HasSeenBroadcast(const uint256& hash) { LOCK(cs); return mapSeenMasternodeBroadcast.count(hash); }
+    bool HasSeenPing(const uint256& hash) { LOCK(cs); return mapSeenMasternodePing.count(hash); }
+
     void UpdateLastPaid();
 
     void CheckAndRebuildMasternodeIndex();
@@ -354,6 +427,9 @@ public:
     bool IsMasternodePingedWithin(const CTxIn& vin, int nSeconds, int64_t nTimeToCheckAt = -1);
     void SetMasternodeLastPing(const CTxIn& vin, const CMasternodePing& mnp);
 
+    /// Keep the pubkey index in sync after pmn->pubKeyMasternode changed
+    void UpdateMasternodePubKey(CMasternode* pmn, const CPubKey& pubKeyMasternodeOld);
+
     void UpdatedBlockTip(const CBlockIndex *pindex);
 
     /**
@@ -19,6 +19,7 @@
 #include "hash.h"
 #include "primitives/transaction.h"
 #include "scheduler.h"
+#include "socketevents.h"
 #include "ui_interface.h"
 #include "wallet/wallet.h"
 #include "utilstrencodings.h"
@@ -32,6 +33,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_UPNP
@@ -69,6 +71,9 @@ using namespace std;
 namespace {
     const int MAX_OUTBOUND_CONNECTIONS = 8;
     const int MAX_OUTBOUND_MASTERNODE_CONNECTIONS = 20;
+    // Milliseconds the socket handler waits for events at most, it also
+    // needs to look at disconnected and throttled nodes every now and then
+    const int64_t SOCKET_EVENTS_TIMEOUT = 50;
 
     struct ListenSocket {
         SOCKET socket;
@@ -97,7 +102,7 @@ std::string strSubVersion;
 
 vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-map<CInv, CDataStream> mapRelay;
+map<CInv, CSerializedNetMsgPtr> mapRelay;
 deque<pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
 limitedmap<uint256, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
@@ -118,6 +123,13 @@ static CSemaphore *semOutbound = NULL;
 static CSemaphore *semMasternodeOutbound = NULL;
 boost::condition_variable messageHandlerCondition;
 
+static int nMessageWorkers = 0;
+static boost::mutex mutexMessageWorkers;
+static boost::condition_variable condMessageWorkers;
+static std::deque<CNode*> queueMessageWorkers;
+/** Set on the message worker threads */
+static boost::thread_specific_ptr<bool> ptrMessageWorkerThread;
+
 // Signals for message handling
 static CNodeSignals g_signals;
 CNodeSignals& GetNodeSignals() { return g_signals; }
@@ -765,25 +777,56 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 
 
 
+#ifndef WIN32
+/** Maximum number of queued messages handed to the kernel by one vectored write */
+static const size_t MAX_SEND_IOVECS = 64;
+#endif
+
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode *pnode)
 {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<CSerializedNetMsgPtr>::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert((*it)->size() > pnode->nSendOffset);
+#ifdef WIN32
+        const CSerializeData &data = **it;
         int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+        // write the queued messages with one system call instead of one each
+        struct iovec vIov[MAX_SEND_IOVECS];
+        size_t nIov = 0;
+        size_t nOffset = pnode->nSendOffset;
+        for (std::deque<CSerializedNetMsgPtr>::iterator itIov = it; itIov != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++itIov) {
+            const CSerializeData &data = **itIov;
+            vIov[nIov].iov_base = const_cast<char*>(&data[nOffset]);
+            vIov[nIov].iov_len = data.size() - nOffset;
+            nIov++;
+            nOffset = 0;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vIov;
+        msg.msg_iovlen = nIov;
+        int nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             pnode->RecordBytesSent(nBytes);
-            if (pnode->nSendOffset == data.size()) {
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                const size_t nSize = (*it)->size();
+                if (nLeft < nSize - pnode->nSendOffset) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nSize - pnode->nSendOffset;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
+                pnode->nSendSize -= nSize;
                 it++;
-            } else {
+            }
+            if (pnode->nSendOffset != 0) {
                 // could not send full message; stop sending more
                 break;
             }
@@ -1015,6 +1058,21 @@ static void AcceptConnection(const ListenSocket& hListenSocket) {
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+
+    CSocketEvents events;
+    LogPrintf("%s: waiting for sockets with %s\n", __func__, events.GetMethodName());
+
+    // listening sockets are registered under negative ids
+    for (unsigned int i = 0; i < vhListenSocket.size(); i++)
+        events.Add(vhListenSocket[i].socket, -1 - (int64_t)i, false);
+
+    // registered nodes, they are removed before leaving vNodes
+    map<NodeId, CNode*> mapEventNodes;
+    vector<CSocketEvent> vEvents;
+    // a socket is known to have more to do, don't wait for new events
+    bool fMoreWork = false;
+    int64_t nLastInactivityCheck = 0;
+
     while (true)
     {
         //
@@ -1040,6 +1098,11 @@ void ThreadSocketHandler()
                     pnode->grantMasternodeOutbound.Release();
 
                     // close socket and cleanup
+                    if (pnode->fSocketEvents) {
+                        events.Remove(pnode->id);
+                        mapEventNodes.erase(pnode->id);
+                        pnode->fSocketEvents = false;
+                    }
                     pnode->CloseSocketDisconnect();
 
                     // hold in disconnected pool until all refs are released
@@ -1087,98 +1150,44 @@ void ThreadSocketHandler()
         }
 
         //
-        // Find which sockets have data to receive
+        // Wait for sockets to become ready. Idle sockets are not reported at
+        // all, and sockets which are ready stay flagged on their node until
+        // recv or send runs into WSAEWOULDBLOCK.
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
+        if (!events.Wait(fMoreWork ? 0 : SOCKET_EVENTS_TIMEOUT, vEvents))
         {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode* pnode, vNodes)
-            {
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
-                // * (if neither of the above applies, there is certainly one message
-                //   in the receiver buffer ready to be processed).
-                // Together, that means that at least one of the following is always possible,
-                // so we don't deadlock:
-                // * We send some data.
-                // * We wait for data to be received (and disconnect after timeout).
-                // * We process a message in the buffer (message handler thread).
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
-                }
-                {
-                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (
-                        pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                        pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
+            LogPrintf("socket wait error %s\n", NetworkErrorString(WSAGetLastError()));
+            MilliSleep(SOCKET_EVENTS_TIMEOUT);
         }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
         boost::this_thread::interruption_point();
+        fMoreWork = false;
 
-        if (nSelect == SOCKET_ERROR)
+        BOOST_FOREACH(const CSocketEvent& event, vEvents)
         {
-            if (have_fds)
+            if (event.nId < 0)
             {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
+                // accept new connections
+                unsigned int nListen = -1 - event.nId;
+                if (nListen < vhListenSocket.size() && vhListenSocket[nListen].socket != INVALID_SOCKET)
+                    AcceptConnection(vhListenSocket[nListen]);
+                continue;
             }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec/1000);
-        }
 
-        //
-        // Accept new connections
-        //
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
-        {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
-            {
-                AcceptConnection(hListenSocket);
-            }
+            map<NodeId, CNode*>::iterator it = mapEventNodes.find(event.nId);
+            if (it == mapEventNodes.end())
+                continue;
+            // errors are picked up by the next recv or send
+            if (event.fRecv || event.fError)
+                it->second->fSocketRecvReady = true;
+            if (event.fSend || event.fError)
+                it->second->fSocketSendReady = true;
         }
 
+        int64_t nTime = GetTime();
+        bool fCheckInactivity = nTime != nLastInactivityCheck;
+        if (fCheckInactivity)
+            nLastInactivityCheck = nTime;
+
         //
         // Service each socket
         //
@@ -1187,66 +1196,113 @@ void ThreadSocketHandler()
         {
             boost::this_thread::interruption_point();
 
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            if (!pnode->fSocketEvents && !pnode->fDisconnect)
+            {
+                // new node, its first events are reported by the next wait
+                if (events.Add(pnode->hSocket, pnode->id, true)) {
+                    mapEventNodes[pnode->id] = pnode;
+                    pnode->fSocketEvents = true;
+                } else {
+                    pnode->fDisconnect = true;
+                }
+                continue;
+            }
+
+            //
+            // Send
+            //
+            // If there is data to send, drain the send buffer before receiving more.
+            // This avoids needlessly queueing received data if the remote peer is
+            // not themselves receiving data, so TCP flow control signalling is used
+            // properly. The message handler sends optimistically, so this is only
+            // left to do when its write did not complete.
+            bool fSendPending = pnode->nSendSize > 0;
+            if (fSendPending && pnode->fSocketSendReady)
+            {
+                TRY_LOCK(pnode->cs_vSend, lockSend);
+                if (lockSend)
+                {
+                    SocketSendData(pnode);
+                    fSendPending = !pnode->vSendMsg.empty();
+                    if (fSendPending) {
+                        // the socket buffer is full
+                        pnode->fSocketSendReady = false;
+                        events.Rearm(pnode->id, false, true);
+                    }
+                }
+                else
+                    fMoreWork = true;
+            }
+
             //
             // Receive
             //
-            if (pnode->hSocket == INVALID_SOCKET)
-                continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError))
+            // Unless there is a complete message in the receive buffer and the
+            // buffer is full, in which case the message handler has to catch up
+            // first.
+            if (!fSendPending && pnode->fSocketRecvReady)
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv)
+                if (!lockRecv)
+                    fMoreWork = true;
+                else if (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+                         pnode->GetTotalRecvSize() <= ReceiveFloodSize())
                 {
+                    // typical socket buffer is 8K-64K
+                    char pchBuf[0x10000];
+                    int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                    if (nBytes > 0)
                     {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0)
+                        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+                            pnode->CloseSocketDisconnect();
+                        pnode->nLastRecv = GetTime();
+                        pnode->nRecvBytes += nBytes;
+                        pnode->RecordBytesRecv(nBytes);
+                        // read on until the socket is drained
+                        fMoreWork = true;
+                    }
+                    else if (nBytes == 0)
+                    {
+                        // socket closed gracefully
+                        if (!pnode->fDisconnect)
+                            LogPrint("net", "socket closed\n");
+                        pnode->CloseSocketDisconnect();
+                    }
+                    else if (nBytes < 0)
+                    {
+                        // error
+                        int nErr = WSAGetLastError();
+                        if (nErr == WSAEWOULDBLOCK)
                         {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                            pnode->nRecvBytes += nBytes;
-                            pnode->RecordBytesRecv(nBytes);
+                            pnode->fSocketRecvReady = false;
+                            events.Rearm(pnode->id, true, false);
                         }
-                        else if (nBytes == 0)
+                        else if (nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
                         {
-                            // socket closed gracefully
                             if (!pnode->fDisconnect)
-                                LogPrint("net", "socket closed\n");
+                                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
                             pnode->CloseSocketDisconnect();
                         }
-                        else if (nBytes < 0)
-                        {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                            {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
+                        else
+                            fMoreWork = true;
                     }
                 }
             }
 
             //
-            // Send
+            // Inactivity checking
             //
-            if (pnode->hSocket == INVALID_SOCKET)
+            if (!fCheckInactivity)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend))
-            {
-                TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
-                    SocketSendData(pnode);
-            }
 
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetTime();
+            // a send which stopped early for another reason than a full buffer
+            // would not be followed by an event, try again once in a while
+            if (fSendPending && !pnode->fSocketSendReady)
+                pnode->fSocketSendReady = true;
+
             if (nTime - pnode->nTimeConnected > 60)
             {
                 if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
@@ -1752,7 +1808,7 @@ void ThreadMessageHandler()
 
         BOOST_FOREACH(CNode* pnode, vNodesCopy)
         {
-            if (pnode->fDisconnect)
+            if (pnode->fDisconnect || pnode->fOnMessageWorker)
                 continue;
 
             // Receive messages
@@ -1763,7 +1819,7 @@ void ThreadMessageHandler()
                     if (!g_signals.ProcessMessages(pnode))
                         pnode->fDisconnect = true;
 
-                    if (pnode->nSendSize < SendBufferSize())
+                    if (pnode->nSendSize < SendBufferSize() && !pnode->fOnMessageWorker)
                     {
                         if (!pnode->vRecvGetData.empty() || (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete()))
                         {
@@ -1774,6 +1830,10 @@ void ThreadMessageHandler()
             }
             boost::this_thread::interruption_point();
 
+            // the worker which just took over the peer may be sending already
+            if (pnode->fOnMessageWorker)
+                continue;
+
             // Send messages
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
@@ -1795,6 +1855,67 @@ void ThreadMessageHandler()
 
 
 
+bool QueueMessageWorker(CNode* pnode)
+{
+    if (nMessageWorkers == 0)
+        return false;
+
+    pnode->fOnMessageWorker = true;
+    pnode->AddRef();
+    {
+        boost::lock_guard<boost::mutex> lock(mutexMessageWorkers);
+        queueMessageWorkers.push_back(pnode);
+    }
+    condMessageWorkers.notify_one();
+    return true;
+}
+
+bool IsMessageWorkerThread()
+{
+    return ptrMessageWorkerThread.get() != NULL;
+}
+
+void ThreadMessageWorker()
+{
+    ptrMessageWorkerThread.reset(new bool(true));
+    SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
+    while (true)
+    {
+        CNode* pnode;
+        {
+            boost::unique_lock<boost::mutex> lock(mutexMessageWorkers);
+            while (queueMessageWorkers.empty())
+                condMessageWorkers.wait(lock);
+            pnode = queueMessageWorkers.front();
+            queueMessageWorkers.pop_front();
+        }
+
+        {
+            LOCK(pnode->cs_vRecvMsg);
+            if (!pnode->fDisconnect && !g_signals.ProcessWorkerMessages(pnode))
+                pnode->fDisconnect = true;
+            pnode->fOnMessageWorker = false;
+        }
+        pnode->Release();
+
+        // hand the peer back to the message handler
+        messageHandlerCondition.notify_one();
+        boost::this_thread::interruption_point();
+    }
+}
+
+void StartMessageWorkers(boost::thread_group& threadGroup, int nWorkers)
+{
+    nMessageWorkers = nWorkers;
+    for (int i = 0; i < nMessageWorkers; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msgworker", &ThreadMessageWorker));
+}
+
+
+
+
+
+
 bool BindListenPort(const CService &addrBind, string& strError, bool fWhitelisted)
 {
     strError = "";
@@ -2012,6 +2133,9 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
     // Process messages
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
 
+    // Process masternode messages
+    StartMessageWorkers(threadGroup, std::max(0, (int)GetArg("-msgworkers", DEFAULT_MESSAGE_WORKERS)));
+
     // Dump network addresses
     scheduler.scheduleEvery(&DumpData, DUMP_ADDRESSES_INTERVAL);
 }
@@ -2084,6 +2208,26 @@ void CExplicitNetCleanup::callCleanup()
     delete tmp; // Stroustrup's gonna kill me for that
 }
 
+CSerializedNetMsgPtr AddRelayMessage(const CInv& inv, const CDataStream& ssPayload)
+{
+    LOCK(cs_mapRelay);
+    // Expire old relay messages
+    while (!vRelayExpiration.empty() && vRelayExpiration.front().first < GetTime())
+    {
+        mapRelay.erase(vRelayExpiration.front().second);
+        vRelayExpiration.pop_front();
+    }
+
+    // Save original serialized message so newer versions are preserved,
+    // it's built once and shared by all peers asking for it
+    std::pair<std::map<CInv, CSerializedNetMsgPtr>::iterator, bool> ret = mapRelay.insert(std::make_pair(inv, CSerializedNetMsgPtr()));
+    if (ret.second) {
+        ret.first->second = MakeSerializedNetMsg(inv.GetCommand(), ssPayload);
+        vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
+    }
+    return ret.first->second;
+}
+
 void RelayTransaction(const CTransaction& tx)
 {
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
@@ -2106,19 +2250,7 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
     int nInv = mapDarksendBroadcastTxes.count(hash) ? MSG_DSTX :
                 (instantsend.HasTxLockRequest(hash) ? MSG_TXLOCK_REQUEST : MSG_TX);
     CInv inv(nInv, hash);
-    {
-        LOCK(cs_mapRelay);
-        // Expire old relay messages
-        while (!vRelayExpiration.empty() && vRelayExpiration.front().first < GetTime())
-        {
-            mapRelay.erase(vRelayExpiration.front().second);
-            vRelayExpiration.pop_front();
-        }
-
-        // Save original serialized message so newer versions are preserved
-        mapRelay.insert(std::make_pair(inv, ss));
-        vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
-    }
+    AddRelayMessage(inv, ss);
     LOCK(cs_vNodes);
     BOOST_FOREACH(CNode* pnode, vNodes)
     {
@@ -2419,6 +2551,10 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     fNetworkNode = fNetworkNodeIn;
     fSuccessfullyConnected = false;
     fDisconnect = false;
+    fSocketEvents = false;
+    fSocketRecvReady = false;
+    fSocketSendReady = false;
+    fOnMessageWorker = false;
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
@@ -2515,6 +2651,36 @@ void CNode::AskFor(const CInv& inv)
     mapAskFor.insert(std::make_pair(nRequestTime, inv));
 }
 
+/** Fill in the size and checksum of a message serialized after a CMessageHeader, returns the payload size */
+static unsigned int FinalizeMessageHeader(CDataStream& ss)
+{
+    // Set the size
+    unsigned int nSize = ss.size() - CMessageHeader::HEADER_SIZE;
+    WriteLE32((uint8_t*)&ss[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
+
+    // Set the checksum
+    uint256 hash = Hash(ss.begin() + CMessageHeader::HEADER_SIZE, ss.end());
+    unsigned int nChecksum = 0;
+    memcpy(&nChecksum, &hash, sizeof(nChecksum));
+    assert(ss.size () >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
+    memcpy((char*)&ss[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+
+    return nSize;
+}
+
+CSerializedNetMsgPtr MakeSerializedNetMsg(const char* pszCommand, const CDataStream& ssPayload)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.reserve(CMessageHeader::HEADER_SIZE + ssPayload.size());
+    ss << CMessageHeader(Params().MessageStart(), pszCommand, 0);
+    ss << ssPayload;
+    FinalizeMessageHeader(ss);
+
+    boost::shared_ptr<CSerializeData> msg(new CSerializeData());
+    ss.GetAndClear(*msg);
+    return msg;
+}
+
 void CNode::BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend)
 {
     ENTER_CRITICAL_SECTION(cs_vSend);
@@ -2551,28 +2717,37 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
         LEAVE_CRITICAL_SECTION(cs_vSend);
         return;
     }
-    // Set the size
-    unsigned int nSize = ssSend.size() - CMessageHeader::HEADER_SIZE;
-    WriteLE32((uint8_t*)&ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
-
-    // Set the checksum
-    uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
-    unsigned int nChecksum = 0;
-    memcpy(&nChecksum, &hash, sizeof(nChecksum));
-    assert(ssSend.size () >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
-    memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+    unsigned int nSize = FinalizeMessageHeader(ssSend);
 
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
+    boost::shared_ptr<CSerializeData> msg(new CSerializeData());
+    ssSend.GetAndClear(*msg);
+    QueueSendMessage(msg);
+
+    LEAVE_CRITICAL_SECTION(cs_vSend);
+}
+
+// requires LOCK(cs_vSend)
+void CNode::QueueSendMessage(const CSerializedNetMsgPtr& msg)
+{
+    vSendMsg.push_back(msg);
+    nSendSize += msg->size();
 
     // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
+    if (vSendMsg.size() == 1)
         SocketSendData(this);
+}
 
-    LEAVE_CRITICAL_SECTION(cs_vSend);
+void CNode::PushSerializedMessage(const CSerializedNetMsgPtr& msg)
+{
+    LOCK(cs_vSend);
+    // like BeginMessage, don't put anything between the parts of a message being built
+    assert(ssSend.size() == 0);
+    const char* pszCommand = &(*msg)[MESSAGE_START_SIZE];
+    LogPrint("net", "sending: %s (%d bytes) peer=%d\n", SanitizeString(std::string(pszCommand, strnlen(pszCommand, CMessageHeader::COMMAND_SIZE))),
+        msg->size() - CMessageHeader::HEADER_SIZE, id);
+    QueueSendMessage(msg);
 }
 
 std::vector<unsigned char> CNode::CalculateKeyedNetGroup(CAddress& address)
@@ -24,8 +24,10 @@
 #include <arpa/inet.h>
 #endif
 
+#include <boost/atomic.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/signals2/signal.hpp>
 
 class CAddrMan;
@@ -72,6 +74,8 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Default number of -msgworkers, the threads processing masternode messages next to the message handler */
+static const int DEFAULT_MESSAGE_WORKERS = 2;
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
@@ -79,6 +83,17 @@ static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Defaul
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
 
+/**
+ * Let a message worker thread process the next messages of a peer via
+ * ProcessWorkerMessages. Returns false if there are no workers.
+ * Requires pnode->cs_vRecvMsg.
+ */
+bool QueueMessageWorker(CNode* pnode);
+/** Start nWorkers message worker threads in threadGroup (0 = none) */
+void StartMessageWorkers(boost::thread_group& threadGroup, int nWorkers);
+/** Whether the calling thread is a message worker */
+bool IsMessageWorkerThread();
+
 void AddOneShot(const std::string& strDest);
 void AddressCurrentlyConnected(const CService& addr);
 CNode* FindNode(const CNetAddr& ip);
@@ -118,6 +133,7 @@ struct CNodeSignals
 {
     boost::signals2::signal<int ()> GetHeight;
     boost::signals2::signal<bool (CNode*), CombinerAll> ProcessMessages;
+    boost::signals2::signal<bool (CNode*), CombinerAll> ProcessWorkerMessages;
     boost::signals2::signal<bool (CNode*), CombinerAll> SendMessages;
     boost::signals2::signal<void (NodeId, const CNode*)> InitializeNode;
     boost::signals2::signal<void (NodeId)> FinalizeNode;
@@ -165,9 +181,21 @@ extern int nMaxConnections;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
+/**
+ * A network message, header included, ready to be sent. It is immutable so
+ * the same buffer can be queued to the send queues of many peers.
+ */
+typedef boost::shared_ptr<const CSerializeData> CSerializedNetMsgPtr;
+
+/** Build a message to be sent to several peers with CNode::PushSerializedMessage */
+CSerializedNetMsgPtr MakeSerializedNetMsg(const char* pszCommand, const CDataStream& ssPayload);
+
+extern std::map<CInv, CSerializedNetMsgPtr> mapRelay;
 extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 extern CCriticalSection cs_mapRelay;
+
+/** Keep the message for inv in relay memory for 15 minutes, returns the one kept there */
+CSerializedNetMsgPtr AddRelayMessage(const CInv& inv, const CDataStream& ssPayload);
 extern limitedmap<uint256, int64_t> mapAlreadyAskedFor;
 
 extern std::vector<std::string> vAddedNodes;
@@ -227,12 +255,15 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    bool fSigChecksQueued;          // signatures were passed to sigcheckqueue
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fSigChecksQueued = false;
     }
 
     bool complete() const
@@ -325,7 +356,7 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSerializedNetMsgPtr> vSendMsg;
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
@@ -356,6 +387,14 @@ public:
     bool fNetworkNode;
     bool fSuccessfullyConnected;
     bool fDisconnect;
+    // Only used by the socket handler thread: the socket was registered with
+    // its CSocketEvents, and readiness reported there that wasn't used up yet
+    bool fSocketEvents;
+    bool fSocketRecvReady;
+    bool fSocketSendReady;
+    // A message worker took over the processing of the peer's messages, the
+    // message handler leaves the peer alone until it's done
+    boost::atomic<bool> fOnMessageWorker;
     // We use fRelayTxes for two purposes -
     // a) it allows us to not relay tx invs before receiving the peer's version message
     // b) the peer may tell us in its version message that we should not relay tx invs
@@ -555,6 +594,12 @@ public:
 
     void PushVersion();
 
+    /** Queue a message built with MakeSerializedNetMsg, without copying it */
+    void PushSerializedMessage(const CSerializedNetMsgPtr& msg);
+
+    // requires LOCK(cs_vSend)
+    void QueueSendMessage(const CSerializedNetMsgPtr& msg);
+
 
     void PushMessage(const char* pszCommand)
     {
@@ -266,11 +266,19 @@ bool static InterruptibleRecv(char* data, size_t len, int timeout, SOCKET& hSock
                 if (!IsSelectableSocket(hSocket)) {
                     return false;
                 }
+#ifdef USE_POLL
+                struct pollfd pollfd;
+                pollfd.fd = hSocket;
+                pollfd.events = POLLIN;
+                pollfd.revents = 0;
+                int nRet = poll(&pollfd, 1, std::min(endTime - curTime, maxWait));
+#else
                 struct timeval tval = MillisToTimeval(std::min(endTime - curTime, maxWait));
                 fd_set fdset;
                 FD_ZERO(&fdset);
                 FD_SET(hSocket, &fdset);
                 int nRet = select(hSocket + 1, &fdset, NULL, NULL, &tval);
+#endif
                 if (nRet == SOCKET_ERROR) {
                     return false;
                 }
@@ -464,11 +472,19 @@ bool static ConnectSocketDirectly(const CService &addrConnect, SOCKET& hSocketRe
         // WSAEINVAL is here because some legacy version of winsock uses it
         if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK || nErr == WSAEINVAL)
         {
+#ifdef USE_POLL
+            struct pollfd pollfd;
+            pollfd.fd = hSocket;
+            pollfd.events = POLLOUT;
+            pollfd.revents = 0;
+            int nRet = poll(&pollfd, 1, nTimeout);
+#else
             struct timeval timeout = MillisToTimeval(nTimeout);
             fd_set fdset;
             FD_ZERO(&fdset);
             FD_SET(hSocket, &fdset);
             int nRet = select(hSocket + 1, NULL, &fdset, NULL, &timeout);
+#endif
             if (nRet == 0)
             {
                 LogPrint("net", "connection to %s timeout\n", addrConnect.ToString());
@@ -11,13 +11,88 @@
 #include "crypto/common.h"
 #include "crypto/neoscrypt.h"
 
+#include <boost/atomic.hpp>
+
+static boost::atomic<uint64_t> nTotalHashEvaluations(0);
+static boost::atomic<uint64_t> nTotalHashCacheHits(0);
+
 uint256 CBlockHeader::GetHash() const
 {
-        uint256 thash;
-        unsigned int profile = 0x0;
-        neoscrypt((unsigned char *) &nVersion, (unsigned char *) &thash, profile);
-        return thash;
+    boost::shared_ptr<const CHashCache> pCache = boost::atomic_load(&pHashCache);
+    if (pCache && memcmp(pCache->vchHeader, &nVersion, HEADER_SIZE) == 0) {
+        nTotalHashCacheHits.fetch_add(1, boost::memory_order_relaxed);
+        return pCache->hash;
+    }
+
+    // Neoscrypt hashes the 80 serialized header bytes in place, starting at nVersion
+    uint256 thash;
+    unsigned int profile = 0x0;
+    neoscrypt((const unsigned char *) &nVersion, (unsigned char *) &thash, profile);
+
+    SetHashCache(thash);
+    return thash;
+}
+
+void CBlockHeader::SetHashCache(const uint256& hash) const
+{
+    boost::shared_ptr<const CHashCache> pOld = boost::atomic_load(&pHashCache);
+    boost::shared_ptr<CHashCache> pCache(new CHashCache);
+    pCache->hash = hash;
+    memcpy(pCache->vchHeader, &nVersion, HEADER_SIZE);
+    pCache->nEvaluations = (pOld ? pOld->nEvaluations : 0) + 1;
+    boost::atomic_store(&pHashCache, boost::shared_ptr<const CHashCache>(pCache));
+    nTotalHashEvaluations.fetch_add(1, boost::memory_order_relaxed);
+}
+
+uint32_t CBlockHeader::GetHashEvaluations() const
+{
+    boost::shared_ptr<const CHashCache> pCache = boost::atomic_load(&pHashCache);
+    return pCache ? pCache->nEvaluations : 0;
+}
+
+uint64_t CBlockHeader::GetTotalHashEvaluations()
+{
+    return nTotalHashEvaluations.load(boost::memory_order_relaxed);
+}
 
+uint64_t CBlockHeader::GetTotalHashCacheHits()
+{
+    return nTotalHashCacheHits.load(boost::memory_order_relaxed);
+}
+
+void GetBlockHeaderHashes(const CBlockHeader* pheaders, size_t nCount, uint256* phashesOut)
+{
+    // Pack the headers lacking a memoized hash back to back for the batch kernel
+    std::vector<size_t> vPending;
+    std::vector<unsigned char> vPasswords;
+    vPending.reserve(nCount);
+    vPasswords.reserve(nCount * CBlockHeader::HEADER_SIZE);
+    for (size_t i = 0; i < nCount; i++) {
+        if (pheaders[i].IsHashCached()) {
+            phashesOut[i] = pheaders[i].GetHash();
+            continue;
+        }
+        const unsigned char* pheader = (const unsigned char*)&pheaders[i].nVersion;
+        vPasswords.insert(vPasswords.end(), pheader, pheader + CBlockHeader::HEADER_SIZE);
+        vPending.push_back(i);
+    }
+    if (vPending.empty())
+        return;
+
+    std::vector<uint256> vHashes(vPending.size());
+    neoscrypt_batch(&vPasswords[0], (unsigned char *) &vHashes[0], vPending.size());
+
+    for (size_t j = 0; j < vPending.size(); j++) {
+        pheaders[vPending[j]].SetHashCache(vHashes[j]);
+        phashesOut[vPending[j]] = vHashes[j];
+    }
+}
+
+void GetBlockHeaderHashes(const std::vector<CBlockHeader>& vHeaders, std::vector<uint256>& vHashesOut)
+{
+    vHashesOut.resize(vHeaders.size());
+    if (!vHeaders.empty())
+        GetBlockHeaderHashes(&vHeaders[0], vHeaders.size(), &vHashesOut[0]);
 }
 
 std::string CBlock::ToString() const
@@ -10,6 +10,10 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <string.h>
+
+#include <boost/shared_ptr.hpp>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -28,11 +32,43 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+    // memory only
+    // The PoW hash is expensive (Neoscrypt), so it is memoized together with
+    // a copy of the 80 header bytes it was computed from. Any mutation of the
+    // header fields makes the snapshot mismatch and forces a recomputation.
+    // A memo is never modified once published, GetHash() swaps in a new one
+    // with boost::atomic_store, so a shared header can be hashed concurrently.
+    static const size_t HEADER_SIZE = 80;
+    struct CHashCache {
+        uint256 hash;
+        unsigned char vchHeader[HEADER_SIZE];
+        uint32_t nEvaluations; // Neoscrypt evaluations done for this header so far
+    };
+    mutable boost::shared_ptr<const CHashCache> pHashCache;
+
     CBlockHeader()
     {
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other)
+    {
+        *this = other;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other)
+    {
+        nVersion = other.nVersion;
+        hashPrevBlock = other.hashPrevBlock;
+        hashMerkleRoot = other.hashMerkleRoot;
+        nTime = other.nTime;
+        nBits = other.nBits;
+        nNonce = other.nNonce;
+        // copies carry the memoized hash along, the snapshot check keeps it honest
+        boost::atomic_store(&pHashCache, boost::atomic_load(&other.pHashCache));
+        return *this;
+    }
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -54,6 +90,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
+        boost::atomic_store(&pHashCache, boost::shared_ptr<const CHashCache>());
     }
 
     bool IsNull() const
@@ -63,6 +100,29 @@ public:
 
     uint256 GetHash() const;
 
+    /** Forget the memoized PoW hash, e.g. after mutating the header in place */
+    void InvalidateHash() const
+    {
+        boost::atomic_store(&pHashCache, boost::shared_ptr<const CHashCache>());
+    }
+
+    /** Whether GetHash() can be answered without a Neoscrypt evaluation */
+    bool IsHashCached() const
+    {
+        boost::shared_ptr<const CHashCache> pCache = boost::atomic_load(&pHashCache);
+        return pCache && memcmp(pCache->vchHeader, &nVersion, HEADER_SIZE) == 0;
+    }
+
+    /** Memoize a PoW hash computed elsewhere (e.g. in a batch) for the current header */
+    void SetHashCache(const uint256& hash) const;
+
+    /** Neoscrypt evaluations done for this header (and the copies it was made from) */
+    uint32_t GetHashEvaluations() const;
+
+    /** Process-wide PoW hash counters, for benchmarking and diagnostics */
+    static uint64_t GetTotalHashEvaluations();
+    static uint64_t GetTotalHashCacheHits();
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
@@ -118,6 +178,8 @@ public:
         block.nTime          = nTime;
         block.nBits          = nBits;
         block.nNonce         = nNonce;
+        // carry the memoized hash over, the snapshot check keeps it honest
+        boost::atomic_store(&block.pHashCache, boost::atomic_load(&pHashCache));
         return block;
     }
 
@@ -125,6 +187,14 @@ public:
 };
 
 
+/** Compute the PoW hashes of a batch of headers, running independent headers
+ * through the SIMD lanes of the Neoscrypt kernel when the CPU supports it.
+ * Hashes already memoized are reused and the new ones are memoized too.
+ */
+void GetBlockHeaderHashes(const CBlockHeader* pheaders, size_t nCount, uint256* phashesOut);
+void GetBlockHeaderHashes(const std::vector<CBlockHeader>& vHeaders, std::vector<uint256>& vHashesOut);
+
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
@@ -215,6 +215,7 @@ static bool rest_block(HTTPRequest* req,
 
     CBlock block;
     CBlockIndex* pblockindex = NULL;
+    CDiskBlockPos pos;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
@@ -224,12 +225,17 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        if (rf == RF_JSON) {
+            if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
+        pos = pblockindex->GetBlockPos();
     }
 
+    // binary and hex output are the stored bytes, read without holding cs_main
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
+    if ((rf == RF_BINARY || rf == RF_HEX) && !ReadRawBlockFromDisk(ssBlock, pos, Params().MessageStart()))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
 
     switch (rf) {
     case RF_BINARY: {
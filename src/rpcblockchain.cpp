@@ -61,14 +61,14 @@ double GetDifficulty(const CBlockIndex* blockindex)
     return dDiff;
 }
 
-UniValue blockheaderToJSON(const CBlockIndex* blockindex)
+static UniValue blockheaderToJSON(const CBlockIndex* blockindex, const CChainTipSnapshot& tip)
 {
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    if (tip.Contains(blockindex))
+        confirmations = tip.nHeight - blockindex->nHeight + 1;
     result.push_back(Pair("confirmations", confirmations));
     result.push_back(Pair("height", blockindex->nHeight));
     result.push_back(Pair("version", blockindex->nVersion));
@@ -82,12 +82,17 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    const CBlockIndex *pnext = confirmations > 1 ? tip[blockindex->nHeight + 1] : NULL;
     if (pnext)
         result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
     return result;
 }
 
+UniValue blockheaderToJSON(const CBlockIndex* blockindex)
+{
+    return blockheaderToJSON(blockindex, *GetChainTipSnapshot());
+}
+
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
 {
     UniValue result(UniValue::VOBJ);
@@ -142,8 +147,7 @@ UniValue getblockcount(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return GetChainTipSnapshot()->nHeight;
 }
 
 UniValue getbestblockhash(const UniValue& params, bool fHelp)
@@ -159,8 +163,7 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    return GetChainTipSnapshot()->hashBlock.GetHex();
 }
 
 UniValue getdifficulty(const UniValue& params, bool fHelp)
@@ -176,14 +179,17 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getdifficulty", "")
         );
 
-    LOCK(cs_main);
-    return GetDifficulty();
+    CChainTipSnapshotPtr tip = GetChainTipSnapshot();
+    if (tip->pindex == NULL)
+        return 1.0;
+    return GetDifficulty(tip->pindex);
 }
 
 UniValue mempoolToJSON(bool fVerbose = false)
 {
     if (fVerbose)
     {
+        const int nTipHeight = GetChainTipSnapshot()->nHeight;
         LOCK(mempool.cs);
         UniValue o(UniValue::VOBJ);
         BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
@@ -196,10 +202,13 @@ UniValue mempoolToJSON(bool fVerbose = false)
             info.push_back(Pair("time", e.GetTime()));
             info.push_back(Pair("height", (int)e.GetHeight()));
             info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
+            info.push_back(Pair("currentpriority", e.GetPriority(nTipHeight)));
             info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
             info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
             info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants()));
+            info.push_back(Pair("ancestorcount", e.GetCountWithAncestors()));
+            info.push_back(Pair("ancestorsize", e.GetSizeWithAncestors()));
+            info.push_back(Pair("ancestorfees", e.GetModFeesWithAncestors()));
             const CTransaction& tx = e.GetTx();
             set<string> setDepends;
             BOOST_FOREACH(const CTxIn& txin, tx.vin)
@@ -258,6 +267,9 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
             "    \"descendantcount\" : n,  (numeric) number of in-mempool descendant transactions (including this one)\n"
             "    \"descendantsize\" : n,   (numeric) size of in-mempool descendants (including this one)\n"
             "    \"descendantfees\" : n,   (numeric) modified fees (see above) of in-mempool descendants (including this one)\n"
+            "    \"ancestorcount\" : n,    (numeric) number of in-mempool ancestor transactions (including this one)\n"
+            "    \"ancestorsize\" : n,     (numeric) size of in-mempool ancestors (including this one)\n"
+            "    \"ancestorfees\" : n,     (numeric) modified fees (see above) of in-mempool ancestors (including this one)\n"
             "    \"depends\" : [           (array) unconfirmed transactions used as inputs for this transaction\n"
             "        \"transactionid\",    (string) parent transaction id\n"
             "       ... ]\n"
@@ -268,8 +280,6 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getrawmempool", "true")
         );
 
-    LOCK(cs_main);
-
     bool fVerbose = false;
     if (params.size() > 0)
         fVerbose = params[0].get_bool();
@@ -326,13 +336,11 @@ UniValue getblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockhash", "1000")
         );
 
-    LOCK(cs_main);
-
     int nHeight = params[0].get_int();
-    if (nHeight < 0 || nHeight > chainActive.Height())
+    const CBlockIndex* pblockindex = (*GetChainTipSnapshot())[nHeight];
+    if (pblockindex == NULL)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = chainActive[nHeight];
     return pblockindex->GetBlockHash().GetHex();
 }
 
@@ -369,8 +377,6 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -378,10 +384,16 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    // Only the lookup needs cs_main, the header fields never change once the
+    // entry exists and the rest is answered from the tip snapshot.
+    CBlockIndex* pblockindex = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+    }
 
     if (!fVerbose)
     {
@@ -521,8 +533,6 @@ UniValue getblock(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -530,27 +540,36 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+        CBlockIndex* pblockindex = mapBlockIndex[hash];
 
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
-    if (!fVerbose)
-    {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        if (fVerbose)
+        {
+            CBlock block;
+            if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+            return blockToJSON(block, pblockindex);
+        }
+
+        pos = pblockindex->GetBlockPos();
     }
 
-    return blockToJSON(block, pblockindex);
+    // the stored bytes are the serialized block, no need to hold cs_main while reading them
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    if(!ReadRawBlockFromDisk(ssBlock, pos, Params().MessageStart()))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+    return HexStr(ssBlock.begin(), ssBlock.end());
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
@@ -104,7 +104,7 @@ UniValue masternode(const UniValue& params, bool fHelp)
         (strCommand != "start" && strCommand != "start-alias" && strCommand != "start-all" && strCommand != "start-missing" &&
          strCommand != "start-disabled" && strCommand != "list" && strCommand != "list-conf" && strCommand != "count" &&
          strCommand != "debug" && strCommand != "current" && strCommand != "winner" && strCommand != "winners" && strCommand != "genkey" &&
-         strCommand != "connect" && strCommand != "outputs" && strCommand != "status"))
+         strCommand != "connect" && strCommand != "outputs" && strCommand != "status" && strCommand != "sigcache"))
             throw std::runtime_error(
                 "masternode \"command\"...\n"
                 "Set of commands to execute masternode related actions\n"
@@ -116,6 +116,7 @@ UniValue masternode(const UniValue& params, bool fHelp)
                 "  debug        - Print masternode status\n"
                 "  genkey       - Generate new masternodeprivkey\n"
                 "  outputs      - Print masternode compatible outputs\n"
+                "  sigcache     - Print statistics of the masternode message signature cache\n"
                 "  start        - Start local Hot masternode configured in cerberus.conf\n"
                 "  start-alias  - Start single remote masternode by assigned alias configured in masternode.conf\n"
                 "  start-<mode> - Start remote masternodes configured in masternode.conf (<mode>: 'all', 'missing', 'disabled')\n"
@@ -383,6 +384,17 @@ UniValue masternode(const UniValue& params, bool fHelp)
 
     }
 
+    if (strCommand == "sigcache")
+    {
+        const CMessageSignatureCache& cache = darkSendSigner.signatureCache;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("entries", (uint64_t)cache.size()));
+        obj.push_back(Pair("usage", (uint64_t)cache.DynamicMemoryUsage()));
+        obj.push_back(Pair("hits", cache.GetHits()));
+        obj.push_back(Pair("misses", cache.GetMisses()));
+        return obj;
+    }
+
     if (strCommand == "status")
     {
         if (!fMasterNode)
@@ -570,6 +570,125 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+size_t getLimitFromParams(const UniValue& params)
+{
+    if (!params[0].isObject())
+        return 0;
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (limitValue.isNull())
+        return 0;
+    if (!limitValue.isNum() || limitValue.get_int() <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be a positive number");
+    return limitValue.get_int();
+}
+
+/** Cursors are the hex encoded index key the next page starts with */
+template <typename Key>
+bool getCursorFromParams(const UniValue& params, const std::vector<std::pair<uint160, int> > &addresses,
+                         Key &cursor, size_t &addressPos)
+{
+    if (!params[0].isObject())
+        return false;
+
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (cursorValue.isNull())
+        return false;
+    if (!cursorValue.isStr() || !IsHex(cursorValue.get_str()))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+
+    CDataStream ss(ParseHex(cursorValue.get_str()), SER_DISK, CLIENT_VERSION);
+    try {
+        ss >> cursor;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+
+    for (addressPos = 0; addressPos < addresses.size(); addressPos++) {
+        if (addresses[addressPos].first == cursor.hashBytes && addresses[addressPos].second == (int)cursor.type)
+            return true;
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to the addresses");
+}
+
+/** A history cursor has to point into the requested start/end heights */
+void checkCursorRange(const CAddressIndexKey &cursor, int start, int end)
+{
+    if (start > 0 && end > 0 && (cursor.blockHeight < start || cursor.blockHeight > end))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor is outside of the start and end heights");
+}
+
+template <typename Key>
+std::string getCursorString(const Key &cursor)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << cursor;
+    return HexStr(ss.begin(), ss.end());
+}
+
+/**
+ * Read up to nLimit entries of the addresses' history, address by address in
+ * height order, starting at the cursor. Returns whether there are more, the
+ * cursor is then updated to where they start.
+ */
+bool getAddressIndexPage(const std::vector<std::pair<uint160, int> > &addresses, int start, int end,
+                         bool fCursor, size_t &addressPos, CAddressIndexKey &cursor, size_t nLimit,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex)
+{
+    addressIndex.clear();
+    if (fCursor)
+        checkCursorRange(cursor, start, end);
+    for (size_t i = fCursor ? addressPos : 0; i < addresses.size() && addressIndex.size() <= nLimit; i++) {
+        const CAddressIndexKey *pFrom = (fCursor && i == addressPos) ? &cursor : NULL;
+        // one more than asked for tells where the next page starts
+        if (!GetAddressIndex(addresses[i].first, addresses[i].second, addressIndex, start, end, pFrom, nLimit + 1 - addressIndex.size())) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        addressPos = i;
+    }
+
+    if (addressIndex.size() <= nLimit)
+        return false;
+
+    cursor = addressIndex.back().first;
+    addressIndex.pop_back();
+    return true;
+}
+
+/**
+ * Add the transactions of an address from the position of the from key on
+ * to mapTxs, keyed by height and index in the block. Stops after nMax of
+ * them unless nMax is 0.
+ */
+void getAddressTxs(const std::pair<uint160, int> &address, int start, int end,
+                   const CAddressIndexKey &from, size_t nMax,
+                   std::map<std::pair<int, unsigned int>, uint256> &mapTxs)
+{
+    // a transaction can have several entries, read more until nMax are found
+    size_t nEntries = nMax;
+    while (true) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressIndex(address.first, address.second, addressIndex, start, end, &from, nEntries)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+
+        size_t nTxs = 0;
+        for (size_t i = 0; i < addressIndex.size(); i++) {
+            const CAddressIndexKey &key = addressIndex[i].first;
+            if (i > 0 && key.txhash == addressIndex[i - 1].first.txhash)
+                continue;
+            if (nMax > 0 && nTxs == nMax)
+                break;
+            nTxs++;
+            mapTxs[std::make_pair(key.blockHeight, key.txindex)] = key.txhash;
+        }
+
+        if (nMax == 0 || nTxs == nMax || addressIndex.size() < nEntries)
+            return;
+        nEntries *= 2;
+    }
+}
+
 UniValue getaddressmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -654,6 +773,8 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\" (number, optional) Return at most this many unspent outputs and a cursor for the rest\n"
+            "  \"cursor\" (string, optional) The cursor returned with the previous page\n"
             "}\n"
             "\nResult\n"
             "[\n"
@@ -666,6 +787,11 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "    \"satoshis\"  (number) The number of satoshis of the output\n"
             "  }\n"
             "]\n"
+            "\nResult with limit or cursor:\n"
+            "{\n"
+            "  \"utxos\"  (array) As above, address by address ordered by txid\n"
+            "  \"cursor\"  (string) Where the next page starts, missing on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -679,13 +805,34 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
 
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    const size_t nLimit = getLimitFromParams(params);
+    CAddressUnspentKey cursor;
+    size_t addressPos = 0;
+    const bool fCursor = getCursorFromParams(params, addresses, cursor, addressPos);
+    bool fMore = false;
+
+    if (nLimit > 0 || fCursor) {
+        // pages are returned in index order, without sorting
+        for (size_t i = fCursor ? addressPos : 0; i < addresses.size() && (nLimit == 0 || unspentOutputs.size() <= nLimit); i++) {
+            const CAddressUnspentKey *pFrom = (fCursor && i == addressPos) ? &cursor : NULL;
+            if (!GetAddressUnspent(addresses[i].first, addresses[i].second, unspentOutputs, pFrom, nLimit > 0 ? nLimit + 1 - unspentOutputs.size() : 0)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
+        if (nLimit > 0 && unspentOutputs.size() > nLimit) {
+            cursor = unspentOutputs.back().first;
+            unspentOutputs.pop_back();
+            fMore = true;
+        }
+    } else {
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
         }
-    }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    }
 
     UniValue result(UniValue::VARR);
 
@@ -705,6 +852,14 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         result.push_back(output);
     }
 
+    if (nLimit > 0 || fCursor) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("utxos", result));
+        if (fMore)
+            page.push_back(Pair("cursor", getCursorString(cursor)));
+        return page;
+    }
+
     return result;
 }
 
@@ -723,6 +878,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many deltas and a cursor for the rest\n"
+            "  \"cursor\" (string, optional) The cursor returned with the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -734,6 +891,11 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult with limit or cursor:\n"
+            "{\n"
+            "  \"deltas\"  (array) As above, address by address in height order\n"
+            "  \"cursor\"  (string) Where the next page starts, missing on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -753,6 +915,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
         }
     }
+    if (!(start > 0 && end > 0))
+        start = end = 0;
 
     std::vector<std::pair<uint160, int> > addresses;
 
@@ -762,13 +926,18 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
 
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
+    const size_t nLimit = getLimitFromParams(params);
+    CAddressIndexKey cursor;
+    size_t addressPos = 0;
+    const bool fCursor = getCursorFromParams(params, addresses, cursor, addressPos);
+    bool fMore = false;
+
+    if (nLimit > 0) {
+        fMore = getAddressIndexPage(addresses, start, end, fCursor, addressPos, cursor, nLimit, addressIndex);
+    } else {
+        for (size_t i = fCursor ? addressPos : 0; i < addresses.size(); i++) {
+            const CAddressIndexKey *pFrom = (fCursor && i == addressPos) ? &cursor : NULL;
+            if (!GetAddressIndex(addresses[i].first, addresses[i].second, addressIndex, start, end, pFrom)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         }
@@ -792,6 +961,14 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         result.push_back(delta);
     }
 
+    if (nLimit > 0 || fCursor) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("deltas", result));
+        if (fMore)
+            page.push_back(Pair("cursor", getCursorString(cursor)));
+        return page;
+    }
+
     return result;
 }
 
@@ -825,22 +1002,16 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalanceValue value;
+        if (!GetAddressBalance((*it).first, (*it).second, value)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += value.balance;
+        received += value.received;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -866,12 +1037,19 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many txids and a cursor for the rest\n"
+            "  \"cursor\" (string, optional) The cursor returned with the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult with limit or cursor:\n"
+            "{\n"
+            "  \"txids\"  (array) As above, in height and block order, each one once\n"
+            "  \"cursor\"  (string) Where the next page starts, missing on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -896,6 +1074,46 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
 
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
+    const size_t nLimit = getLimitFromParams(params);
+    CAddressIndexKey cursor;
+    size_t addressPos = 0;
+    bool fCursor = getCursorFromParams(params, addresses, cursor, addressPos);
+
+    if (nLimit > 0 || fCursor) {
+        if (!(start > 0 && end > 0))
+            start = end = 0;
+        if (fCursor)
+            checkCursorRange(cursor, start, end);
+
+        // Pages list the txids of all the addresses in height order, each one
+        // once. The first nLimit transactions from the cursor on are among the
+        // first nLimit of every single address, one more tells where the next
+        // page starts.
+        std::map<std::pair<int, unsigned int>, uint256> mapTxs;
+        for (size_t i = 0; i < addresses.size(); i++) {
+            CAddressIndexKey from(addresses[i].second, addresses[i].first, fCursor ? cursor.blockHeight : start,
+                                  fCursor ? cursor.txindex : 0, uint256(), 0, false);
+            getAddressTxs(addresses[i], start, end, from, nLimit > 0 ? nLimit + 1 : 0, mapTxs);
+        }
+
+        UniValue txidsPage(UniValue::VARR);
+        bool fMore = false;
+        for (std::map<std::pair<int, unsigned int>, uint256>::const_iterator it = mapTxs.begin(); it != mapTxs.end(); it++) {
+            if (nLimit > 0 && txidsPage.size() == nLimit) {
+                cursor = CAddressIndexKey(addresses[0].second, addresses[0].first, it->first.first, it->first.second, uint256(), 0, false);
+                fMore = true;
+                break;
+            }
+            txidsPage.push_back(it->second.GetHex());
+        }
+
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("txids", txidsPage));
+        if (fMore)
+            page.push_back(Pair("cursor", getCursorString(cursor)));
+        return page;
+    }
+
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
         if (start > 0 && end > 0) {
             if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
@@ -8,6 +8,7 @@
 #include "rpcserver.h"
 
 #include "base58.h"
+#include "checkqueue.h"
 #include "init.h"
 #include "random.h"
 #include "sync.h"
@@ -255,153 +256,153 @@ UniValue stop(const UniValue& params, bool fHelp)
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode okConcurrent
+  //  --------------------- ------------------------  -----------------------  ---------- ------------
     /* Overall control/query calls */
-    { "control",            "getinfo",                &getinfo,                true  }, /* uses wallet if enabled */
-    { "control",            "debug",                  &debug,                  true  },
-    { "control",            "help",                   &help,                   true  },
-    { "control",            "stop",                   &stop,                   true  },
+    { "control",            "getinfo",                &getinfo,                true,      false }, /* uses wallet if enabled */
+    { "control",            "debug",                  &debug,                  true,      false },
+    { "control",            "help",                   &help,                   true,      false },
+    { "control",            "stop",                   &stop,                   true,      false },
 
     /* P2P networking */
-    { "network",            "getnetworkinfo",         &getnetworkinfo,         true  },
-    { "network",            "addnode",                &addnode,                true  },
-    { "network",            "disconnectnode",         &disconnectnode,         true  },
-    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true  },
-    { "network",            "getconnectioncount",     &getconnectioncount,     true  },
-    { "network",            "getnettotals",           &getnettotals,           true  },
-    { "network",            "getpeerinfo",            &getpeerinfo,            true  },
-    { "network",            "ping",                   &ping,                   true  },
-    { "network",            "setban",                 &setban,                 true  },
-    { "network",            "listbanned",             &listbanned,             true  },
-    { "network",            "clearbanned",            &clearbanned,            true  },
+    { "network",            "getnetworkinfo",         &getnetworkinfo,         true,      true  },
+    { "network",            "addnode",                &addnode,                true,      false },
+    { "network",            "disconnectnode",         &disconnectnode,         true,      false },
+    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,      false },
+    { "network",            "getconnectioncount",     &getconnectioncount,     true,      true  },
+    { "network",            "getnettotals",           &getnettotals,           true,      true  },
+    { "network",            "getpeerinfo",            &getpeerinfo,            true,      true  },
+    { "network",            "ping",                   &ping,                   true,      false },
+    { "network",            "setban",                 &setban,                 true,      false },
+    { "network",            "listbanned",             &listbanned,             true,      false },
+    { "network",            "clearbanned",            &clearbanned,            true,      false },
 
     /* Block chain and UTXO */
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true  },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true  },
-    { "blockchain",         "getblockcount",          &getblockcount,          true  },
-    { "blockchain",         "getblock",               &getblock,               true  },
-    { "blockchain",         "getblockhashes",         &getblockhashes,         true  },
-    { "blockchain",         "getblockhash",           &getblockhash,           true  },
-    { "blockchain",         "getblockheader",         &getblockheader,         true  },
-    { "blockchain",         "getblockheaders",        &getblockheaders,        true  },
-    { "blockchain",         "getchaintips",           &getchaintips,           true  },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
-    { "blockchain",         "gettxout",               &gettxout,               true  },
-    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
-    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
-    { "blockchain",         "verifychain",            &verifychain,            true  },
-    { "blockchain",         "getspentinfo",           &getspentinfo,           false },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,      true  },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,      true  },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,      true  },
+    { "blockchain",         "getblock",               &getblock,               true,      true  },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         true,      true  },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,      true  },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,      true  },
+    { "blockchain",         "getblockheaders",        &getblockheaders,        true,      true  },
+    { "blockchain",         "getchaintips",           &getchaintips,           true,      true  },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,      true  },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,      true  },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,      true  },
+    { "blockchain",         "gettxout",               &gettxout,               true,      true  },
+    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true,      true  },
+    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true,      true  },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,      false },
+    { "blockchain",         "verifychain",            &verifychain,            true,      false },
+    { "blockchain",         "getspentinfo",           &getspentinfo,           false,     true  },
 
     /* Mining */
-    { "mining",             "getblocktemplate",       &getblocktemplate,       true  },
-    { "mining",             "getmininginfo",          &getmininginfo,          true  },
-    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true  },
-    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true  },
-    { "mining",             "submitblock",            &submitblock,            true  },
+    { "mining",             "getblocktemplate",       &getblocktemplate,       true,      false },
+    { "mining",             "getmininginfo",          &getmininginfo,          true,      false },
+    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,      false },
+    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,      false },
+    { "mining",             "submitblock",            &submitblock,            true,      false },
 
     /* Coin generation */
-    { "generating",         "getgenerate",            &getgenerate,            true  },
-    { "generating",         "setgenerate",            &setgenerate,            true  },
-    { "generating",         "generate",               &generate,               true  },
+    { "generating",         "getgenerate",            &getgenerate,            true,      false },
+    { "generating",         "setgenerate",            &setgenerate,            true,      false },
+    { "generating",         "generate",               &generate,               true,      false },
 
     /* Raw transactions */
-    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true  },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true  },
-    { "rawtransactions",    "decodescript",           &decodescript,           true  },
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true  },
-    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false },
-    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false }, /* uses wallet if enabled */
+    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,      false },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,      true  },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,      true  },
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,      true  },
+    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false,     false },
+    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false,     false }, /* uses wallet if enabled */
 #ifdef ENABLE_WALLET
-    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false },
+    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false,     false },
 #endif
 
     /* Address index */
-    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  },
-    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false },
-    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false },
-    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false },
-    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false },
+    { "addressindex",       "getaddressmempool",      &getaddressmempool,      true,      true  },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        false,     true  },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false,     true  },
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false,     true  },
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      false,     true  },
 
     /* Utility functions */
-    { "util",               "createmultisig",         &createmultisig,         true  },
-    { "util",               "validateaddress",        &validateaddress,        true  }, /* uses wallet if enabled */
-    { "util",               "verifymessage",          &verifymessage,          true  },
-    { "util",               "estimatefee",            &estimatefee,            true  },
-    { "util",               "estimatepriority",       &estimatepriority,       true  },
-    { "util",               "estimatesmartfee",       &estimatesmartfee,       true  },
-    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true  },
+    { "util",               "createmultisig",         &createmultisig,         true,      false },
+    { "util",               "validateaddress",        &validateaddress,        true,      true  }, /* uses wallet if enabled */
+    { "util",               "verifymessage",          &verifymessage,          true,      true  },
+    { "util",               "estimatefee",            &estimatefee,            true,      true  },
+    { "util",               "estimatepriority",       &estimatepriority,       true,      true  },
+    { "util",               "estimatesmartfee",       &estimatesmartfee,       true,      true  },
+    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true,      true  },
 
     /* Not shown in help */
-    { "hidden",             "invalidateblock",        &invalidateblock,        true  },
-    { "hidden",             "reconsiderblock",        &reconsiderblock,        true  },
-    { "hidden",             "setmocktime",            &setmocktime,            true  },
+    { "hidden",             "invalidateblock",        &invalidateblock,        true,      false },
+    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,      false },
+    { "hidden",             "setmocktime",            &setmocktime,            true,      false },
 #ifdef ENABLE_WALLET
-    { "hidden",             "resendwallettransactions", &resendwallettransactions, true},
+    { "hidden",             "resendwallettransactions", &resendwallettransactions, true,      false },
 #endif
 
     /* Cerberus features */
-    { "cerberus",               "masternode",             &masternode,             true  },
-    { "cerberus",               "masternodelist",         &masternodelist,         true  },
-    { "cerberus",               "masternodebroadcast",    &masternodebroadcast,    true  },
-    { "cerberus",               "gobject",                &gobject,                true  },
-    { "cerberus",               "getgovernanceinfo",      &getgovernanceinfo,      true  },
-    { "cerberus",               "getsuperblockbudget",    &getsuperblockbudget,    true  },
-    { "cerberus",               "voteraw",                &voteraw,                true  },
-    { "cerberus",               "mnsync",                 &mnsync,                 true  },
-    { "cerberus",               "spork",                  &spork,                  true  },
-    { "cerberus",               "getpoolinfo",            &getpoolinfo,            true  },
+    { "cerberus",               "masternode",             &masternode,             true,      false },
+    { "cerberus",               "masternodelist",         &masternodelist,         true,      false },
+    { "cerberus",               "masternodebroadcast",    &masternodebroadcast,    true,      false },
+    { "cerberus",               "gobject",                &gobject,                true,      false },
+    { "cerberus",               "getgovernanceinfo",      &getgovernanceinfo,      true,      false },
+    { "cerberus",               "getsuperblockbudget",    &getsuperblockbudget,    true,      false },
+    { "cerberus",               "voteraw",                &voteraw,                true,      false },
+    { "cerberus",               "mnsync",                 &mnsync,                 true,      false },
+    { "cerberus",               "spork",                  &spork,                  true,      false },
+    { "cerberus",               "getpoolinfo",            &getpoolinfo,            true,      false },
 #ifdef ENABLE_WALLET
-    { "cerberus",               "privatesend",            &privatesend,            false },
+    { "cerberus",               "privatesend",            &privatesend,            false,     false },
 
     /* Wallet */
-    { "wallet",             "keepass",                &keepass,                true },
-    { "wallet",             "instantsendtoaddress",   &instantsendtoaddress,   false },
-    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true  },
-    { "wallet",             "backupwallet",           &backupwallet,           true  },
-    { "wallet",             "dumpprivkey",            &dumpprivkey,            true  },
-    { "wallet",             "dumpwallet",             &dumpwallet,             true  },
-    { "wallet",             "encryptwallet",          &encryptwallet,          true  },
-    { "wallet",             "getaccountaddress",      &getaccountaddress,      true  },
-    { "wallet",             "getaccount",             &getaccount,             true  },
-    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true  },
-    { "wallet",             "getbalance",             &getbalance,             false },
-    { "wallet",             "getnewaddress",          &getnewaddress,          true  },
-    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true  },
-    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false },
-    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false },
-    { "wallet",             "gettransaction",         &gettransaction,         false },
-    { "wallet",             "abandontransaction",     &abandontransaction,     false },
-    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false },
-    { "wallet",             "getwalletinfo",          &getwalletinfo,          false },
-    { "wallet",             "importprivkey",          &importprivkey,          true  },
-    { "wallet",             "importwallet",           &importwallet,           true  },
-    { "wallet",             "importelectrumwallet",   &importelectrumwallet,   true  },
-    { "wallet",             "importaddress",          &importaddress,          true  },
-    { "wallet",             "importpubkey",           &importpubkey,           true  },
-    { "wallet",             "keypoolrefill",          &keypoolrefill,          true  },
-    { "wallet",             "listaccounts",           &listaccounts,           false },
-    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false },
-    { "wallet",             "listlockunspent",        &listlockunspent,        false },
-    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false },
-    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false },
-    { "wallet",             "listsinceblock",         &listsinceblock,         false },
-    { "wallet",             "listtransactions",       &listtransactions,       false },
-    { "wallet",             "listunspent",            &listunspent,            false },
-    { "wallet",             "lockunspent",            &lockunspent,            true  },
-    { "wallet",             "move",                   &movecmd,                false },
-    { "wallet",             "sendfrom",               &sendfrom,               false },
-    { "wallet",             "sendmany",               &sendmany,               false },
-    { "wallet",             "sendtoaddress",          &sendtoaddress,          false },
-    { "wallet",             "setaccount",             &setaccount,             true  },
-    { "wallet",             "settxfee",               &settxfee,               true  },
-    { "wallet",             "signmessage",            &signmessage,            true  },
-    { "wallet",             "walletlock",             &walletlock,             true  },
-    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true  },
-    { "wallet",             "walletpassphrase",       &walletpassphrase,       true  },
+    { "wallet",             "keepass",                &keepass,                true,      false },
+    { "wallet",             "instantsendtoaddress",   &instantsendtoaddress,   false,     false },
+    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true,      false },
+    { "wallet",             "backupwallet",           &backupwallet,           true,      false },
+    { "wallet",             "dumpprivkey",            &dumpprivkey,            true,      false },
+    { "wallet",             "dumpwallet",             &dumpwallet,             true,      false },
+    { "wallet",             "encryptwallet",          &encryptwallet,          true,      false },
+    { "wallet",             "getaccountaddress",      &getaccountaddress,      true,      false },
+    { "wallet",             "getaccount",             &getaccount,             true,      false },
+    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true,      false },
+    { "wallet",             "getbalance",             &getbalance,             false,     false },
+    { "wallet",             "getnewaddress",          &getnewaddress,          true,      false },
+    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true,      false },
+    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false,     false },
+    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false,     false },
+    { "wallet",             "gettransaction",         &gettransaction,         false,     false },
+    { "wallet",             "abandontransaction",     &abandontransaction,     false,     false },
+    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false,     false },
+    { "wallet",             "getwalletinfo",          &getwalletinfo,          false,     false },
+    { "wallet",             "importprivkey",          &importprivkey,          true,      false },
+    { "wallet",             "importwallet",           &importwallet,           true,      false },
+    { "wallet",             "importelectrumwallet",   &importelectrumwallet,   true,      false },
+    { "wallet",             "importaddress",          &importaddress,          true,      false },
+    { "wallet",             "importpubkey",           &importpubkey,           true,      false },
+    { "wallet",             "keypoolrefill",          &keypoolrefill,          true,      false },
+    { "wallet",             "listaccounts",           &listaccounts,           false,     false },
+    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false,     false },
+    { "wallet",             "listlockunspent",        &listlockunspent,        false,     false },
+    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false,     false },
+    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false,     false },
+    { "wallet",             "listsinceblock",         &listsinceblock,         false,     false },
+    { "wallet",             "listtransactions",       &listtransactions,       false,     false },
+    { "wallet",             "listunspent",            &listunspent,            false,     false },
+    { "wallet",             "lockunspent",            &lockunspent,            true,      false },
+    { "wallet",             "move",                   &movecmd,                false,     false },
+    { "wallet",             "sendfrom",               &sendfrom,               false,     false },
+    { "wallet",             "sendmany",               &sendmany,               false,     false },
+    { "wallet",             "sendtoaddress",          &sendtoaddress,          false,     false },
+    { "wallet",             "setaccount",             &setaccount,             true,      false },
+    { "wallet",             "settxfee",               &settxfee,               true,      false },
+    { "wallet",             "signmessage",            &signmessage,            true,      false },
+    { "wallet",             "walletlock",             &walletlock,             true,      false },
+    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true,      false },
+    { "wallet",             "walletpassphrase",       &walletpassphrase,       true,      false },
 #endif // ENABLE_WALLET
 };
 
@@ -527,11 +528,96 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+/**
+ * Closure representing one call of a batch request, executed on the batch
+ * threads. It always succeeds, errors are reported in the result.
+ */
+class CRPCBatchCall
+{
+private:
+    const UniValue *pReq;
+    UniValue *pResult;
+
+public:
+    CRPCBatchCall() : pReq(NULL), pResult(NULL) {}
+    CRPCBatchCall(const UniValue* pReqIn, UniValue* pResultIn) : pReq(pReqIn), pResult(pResultIn) {}
+
+    bool operator()() {
+        // finish the call even when shutting down, the HTTP worker waits for it
+        boost::this_thread::disable_interruption di;
+        *pResult = JSONRPCExecOne(*pReq);
+        return true;
+    }
+
+    void swap(CRPCBatchCall &call) {
+        std::swap(pReq, call.pReq);
+        std::swap(pResult, call.pResult);
+    }
+};
+
+static CCheckQueue<CRPCBatchCall> batchqueue(1);
+/** A check queue has a single master, a batch arriving while it's busy runs on its HTTP worker only */
+static CCriticalSection cs_batchqueue;
+static int nRPCBatchThreads = 0;
+
+static void ThreadRPCBatch()
+{
+    RenameThread("cerberus-rpcbatch");
+    batchqueue.Thread();
+}
+
+void StartRPCBatchThreads(boost::thread_group& threadGroup)
+{
+    nRPCBatchThreads = std::max((int)GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), 0);
+    for (int i = 0; i < nRPCBatchThreads; i++)
+        threadGroup.create_thread(&ThreadRPCBatch);
+}
+
+static bool IsConcurrentRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& valMethod = find_value(req.get_obj(), "method");
+    if (!valMethod.isStr())
+        return false;
+    const CRPCCommand *pcmd = tableRPC[valMethod.get_str()];
+    return pcmd && pcmd->okConcurrent;
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
+    std::vector<UniValue> vResults(vReq.size());
+
+    unsigned int reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        // Calls which don't change anything are run in parallel with their
+        // neighbours, everything else in order on this thread.
+        unsigned int reqEnd = reqIdx;
+        while (reqEnd < vReq.size() && IsConcurrentRequest(vReq[reqEnd]))
+            reqEnd++;
+
+        if (reqEnd - reqIdx > 1 && nRPCBatchThreads > 0) {
+            TRY_LOCK(cs_batchqueue, lockQueue);
+            if (lockQueue) {
+                std::vector<CRPCBatchCall> vCalls;
+                vCalls.reserve(reqEnd - reqIdx);
+                for (; reqIdx < reqEnd; reqIdx++)
+                    vCalls.push_back(CRPCBatchCall(&vReq[reqIdx], &vResults[reqIdx]));
+
+                CCheckQueueControl<CRPCBatchCall> control(&batchqueue);
+                control.Add(vCalls);
+                control.Wait();
+                continue;
+            }
+        }
+
+        vResults[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+        reqIdx++;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    for (unsigned int i = 0; i < vResults.size(); i++)
+        ret.push_back(vResults[i]);
 
     return ret.write() + "\n";
 }
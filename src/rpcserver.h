@@ -21,6 +21,13 @@
 
 class CRPCCommand;
 
+namespace boost {
+class thread_group;
+} // namespace boost
+
+/** Default number of threads running the read-only calls of a batch in parallel */
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
+
 namespace RPCServer
 {
     void OnStarted(boost::function<void ()> slot);
@@ -120,6 +127,8 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    //! Doesn't change any state, so it may run in parallel with the other calls of a batch
+    bool okConcurrent;
 };
 
 /**
@@ -299,6 +308,8 @@ extern UniValue getspentinfo(const UniValue& params, bool fHelp);
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
+/** Start the threads executing batch requests, see -rpcbatchthreads */
+void StartRPCBatchThreads(boost::thread_group& threadGroup);
 std::string JSONRPCExecBatch(const UniValue& vReq);
 
 #endif // BITCOIN_RPCSERVER_H
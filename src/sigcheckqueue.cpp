@@ -0,0 +1,262 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigcheckqueue.h"
+
+#include "chainparams.h"
+#include "darksend.h"
+#include "governance-vote.h"
+#include "hash.h"
+#include "instantx.h"
+#include "main.h"
+#include "masternode-payments.h"
+#include "masternode-sync.h"
+#include "masternodeman.h"
+#include "net.h"
+#include "util.h"
+
+#include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
+
+CSignatureCheckQueue sigcheckqueue(16, MAX_SIGCHECK_RESULTS);
+
+CSignatureCheck::CSignatureCheck(const std::string& strMessage, const std::vector<unsigned char>& vchSigIn)
+    : hashMessage(CDarkSendSigner::GetMessageHash(strMessage)),
+      vchSig(vchSigIn)
+{}
+
+uint256 CSignatureCheck::GetHash() const
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << hashMessage;
+    ss << vchSig;
+    return ss.GetHash();
+}
+
+bool CSignatureCheck::operator()(CKeyID& keyIDRet) const
+{
+    CPubKey pubkeyFromSig;
+    if(!pubkeyFromSig.RecoverCompact(hashMessage, vchSig)) {
+        return false;
+    }
+    keyIDRet = pubkeyFromSig.GetID();
+    return true;
+}
+
+CSignatureCheckQueue::CSignatureCheckQueue(unsigned int nBatchSizeIn, unsigned int nMaxChecksIn)
+    : nWorkers(0),
+      nBatchSize(nBatchSizeIn),
+      nMaxChecks(nMaxChecksIn)
+{}
+
+void CSignatureCheckQueue::Thread()
+{
+    std::vector<std::pair<uint256, CSignatureCheck> > vChecks;
+    vChecks.reserve(nBatchSize);
+    std::vector<std::pair<bool, CKeyID> > vResults;
+    vResults.reserve(nBatchSize);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nWorkers++;
+    try {
+        while(true) {
+            // publish the results of the previous batch
+            for(unsigned int i = 0; i < vChecks.size(); i++) {
+                std::map<uint256, CheckEntry>::iterator it = mapChecks.find(vChecks[i].first);
+                if(it == mapChecks.end()) continue;
+                it->second.state = CHECK_DONE;
+                it->second.fRecovered = vResults[i].first;
+                it->second.keyID = vResults[i].second;
+            }
+            if(!vChecks.empty()) {
+                condResult.notify_all();
+            }
+            vChecks.clear();
+            vResults.clear();
+
+            while(queue.empty()) {
+                condWorker.wait(lock);
+            }
+
+            while(!queue.empty() && vChecks.size() < nBatchSize) {
+                std::map<uint256, CheckEntry>::iterator it = mapChecks.find(queue.front());
+                queue.pop_front();
+                // expired or taken by the message handler in the meantime
+                if(it == mapChecks.end()) continue;
+                it->second.state = CHECK_RUNNING;
+                vChecks.push_back(std::make_pair(it->first, it->second.check));
+            }
+
+            lock.unlock();
+            for(unsigned int i = 0; i < vChecks.size(); i++) {
+                CKeyID keyID;
+                bool fRecovered = vChecks[i].second(keyID);
+                vResults.push_back(std::make_pair(fRecovered, keyID));
+            }
+            lock.lock();
+        }
+    } catch(...) {
+        // checks still marked as running must not be waited for
+        for(unsigned int i = 0; i < vChecks.size(); i++) {
+            mapChecks.erase(vChecks[i].first);
+        }
+        nWorkers--;
+        condResult.notify_all();
+        throw;
+    }
+}
+
+bool CSignatureCheckQueue::IsEnabled()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nWorkers > 0;
+}
+
+void CSignatureCheckQueue::LimitSize()
+{
+    while(dequeChecks.size() > nMaxChecks) {
+        std::map<uint256, CheckEntry>::iterator it = mapChecks.find(dequeChecks.front());
+        if(it != mapChecks.end()) {
+            // a worker is about to write the result, try again next time
+            if(it->second.state == CHECK_RUNNING) break;
+            mapChecks.erase(it);
+        }
+        dequeChecks.pop_front();
+    }
+}
+
+void CSignatureCheckQueue::Add(std::vector<CSignatureCheck>& vChecks)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if(nWorkers == 0) return;
+
+    unsigned int nAdded = 0;
+    BOOST_FOREACH(CSignatureCheck& check, vChecks) {
+        uint256 hash = check.GetHash();
+        if(mapChecks.count(hash)) continue;
+        CheckEntry& entry = mapChecks[hash];
+        entry.check.hashMessage = check.hashMessage;
+        entry.check.vchSig.swap(check.vchSig);
+        entry.state = CHECK_QUEUED;
+        entry.fRecovered = false;
+        queue.push_back(hash);
+        dequeChecks.push_back(hash);
+        nAdded++;
+    }
+    LimitSize();
+
+    if(nAdded == 1) {
+        condWorker.notify_one();
+    } else if(nAdded > 1) {
+        condWorker.notify_all();
+    }
+}
+
+bool CSignatureCheckQueue::GetResult(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, bool& fRecoveredRet, CKeyID& keyIDRet)
+{
+    CSignatureCheck check;
+    check.hashMessage = hashMessage;
+    check.vchSig = vchSig;
+    uint256 hash = check.GetHash();
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while(true) {
+        std::map<uint256, CheckEntry>::iterator it = mapChecks.find(hash);
+        if(it == mapChecks.end()) return false;
+
+        switch(it->second.state) {
+            case CHECK_QUEUED:
+                // cheaper to do it here than to wait for the checks in front of it,
+                // workers skip checks which are gone
+                mapChecks.erase(it);
+                return false;
+            case CHECK_DONE:
+                fRecoveredRet = it->second.fRecovered;
+                keyIDRet = it->second.keyID;
+                mapChecks.erase(it);
+                return true;
+            case CHECK_RUNNING:
+                condResult.wait(lock);
+                break;
+        }
+    }
+}
+
+void ThreadSignatureCheck()
+{
+    RenameThread("cerberus-sigcheck");
+    sigcheckqueue.Thread();
+}
+
+static void GetSignatureChecks(const std::string& strCommand, CDataStream& vRecv, std::vector<CSignatureCheck>& vChecks)
+{
+    if(strCommand == NetMsgType::MNANNOUNCE) {
+        CMasternodeBroadcast mnb;
+        vRecv >> mnb;
+        if(mnodeman.HasSeenBroadcast(mnb.GetHash())) return;
+        vChecks.push_back(CSignatureCheck(mnb.GetSignatureMessage(), mnb.vchSig));
+        if(!mnb.lastPing.vchSig.empty()) {
+            vChecks.push_back(CSignatureCheck(mnb.lastPing.GetSignatureMessage(), mnb.lastPing.vchSig));
+        }
+    } else if(strCommand == NetMsgType::MNPING) {
+        CMasternodePing mnp;
+        vRecv >> mnp;
+        if(mnodeman.HasSeenPing(mnp.GetHash())) return;
+        vChecks.push_back(CSignatureCheck(mnp.GetSignatureMessage(), mnp.vchSig));
+    } else if(strCommand == NetMsgType::MNVERIFY) {
+        CMasternodeVerification mnv;
+        vRecv >> mnv;
+        // only broadcasts carry both signatures, requests and replies are rare
+        if(mnv.vchSig1.empty() || mnv.vchSig2.empty()) return;
+        uint256 blockHash;
+        if(!GetBlockHash(blockHash, mnv.nBlockHeight)) return;
+        vChecks.push_back(CSignatureCheck(mnv.GetSignatureMessage1(blockHash), mnv.vchSig1));
+        vChecks.push_back(CSignatureCheck(mnv.GetSignatureMessage2(blockHash), mnv.vchSig2));
+    } else if(strCommand == NetMsgType::MASTERNODEPAYMENTVOTE) {
+        // the vote is ignored until then anyway
+        if(!masternodeSync.IsMasternodeListSynced()) return;
+        CMasternodePaymentVote vote;
+        vRecv >> vote;
+        vChecks.push_back(CSignatureCheck(vote.GetSignatureMessage(), vote.vchSig));
+    } else if(strCommand == NetMsgType::TXLOCKVOTE) {
+        CTxLockVote vote;
+        vRecv >> vote;
+        vChecks.push_back(CSignatureCheck(vote.GetSignatureMessage(), vote.GetSignature()));
+    } else if(strCommand == NetMsgType::MNGOVERNANCEOBJECTVOTE) {
+        if(!masternodeSync.IsMasternodeListSynced()) return;
+        CGovernanceVote vote;
+        vRecv >> vote;
+        vChecks.push_back(CSignatureCheck(vote.GetSignatureMessage(), vote.GetSignature()));
+    }
+}
+
+void QueueSignatureChecks(CNode* pfrom)
+{
+    if(fLiteMode || pfrom->fDisconnect || !sigcheckqueue.IsEnabled()) return;
+
+    const CChainParams& chainparams = Params();
+    std::vector<CSignatureCheck> vChecks;
+
+    BOOST_FOREACH(CNetMessage& msg, pfrom->vRecvMsg) {
+        if(!msg.complete()) break;
+        if(msg.fSigChecksQueued) continue;
+        msg.fSigChecksQueued = true;
+
+        if(!msg.hdr.IsValid(chainparams.MessageStart())) continue;
+
+        // work on a copy, the message itself is processed later
+        CDataStream vRecv(msg.vRecv.begin(), msg.vRecv.begin() + msg.hdr.nMessageSize, msg.vRecv.GetType(), msg.vRecv.GetVersion());
+        try {
+            GetSignatureChecks(msg.hdr.GetCommand(), vRecv, vChecks);
+        } catch(const std::exception&) {
+            // malformed messages are reported when they are processed
+            continue;
+        }
+    }
+
+    if(!vChecks.empty()) {
+        LogPrint("masternode", "QueueSignatureChecks -- queued %d signatures, peer=%d\n", vChecks.size(), pfrom->id);
+        sigcheckqueue.Add(vChecks);
+    }
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SIGCHECKQUEUE_H
+#define SIGCHECKQUEUE_H
+
+#include "pubkey.h"
+#include "uint256.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CNode;
+
+/** Maximum number of signature results kept for the message handler */
+static const unsigned int MAX_SIGCHECK_RESULTS = 10000;
+
+/**
+ * A compact signature over a message signed with CDarkSendSigner::SignMessage
+ */
+class CSignatureCheck
+{
+public:
+    uint256 hashMessage;
+    std::vector<unsigned char> vchSig;
+
+    CSignatureCheck() : hashMessage(), vchSig() {}
+    CSignatureCheck(const std::string& strMessage, const std::vector<unsigned char>& vchSigIn);
+
+    /// Identifies the check, so the same signature is only recovered once
+    uint256 GetHash() const;
+
+    /// Recover the key which produced the signature
+    bool operator()(CKeyID& keyIDRet) const;
+};
+
+/**
+ * Queue for signature recoveries that were requested ahead of time.
+ *
+ * The message handler thread pushes the signatures of masternode messages
+ * which are still waiting in the receive buffers of peers, and worker
+ * threads recover the signing keys while earlier messages are processed.
+ * When the message is eventually processed in its usual order,
+ * CDarkSendSigner::VerifyMessage picks up the result instead of
+ * recovering the key again. A check which was not started yet is taken
+ * back by the caller and done inline, so the handler never waits for the
+ * queue to drain.
+ */
+class CSignatureCheckQueue
+{
+private:
+    enum CheckState {
+        CHECK_QUEUED,
+        CHECK_RUNNING,
+        CHECK_DONE
+    };
+
+    struct CheckEntry {
+        CSignatureCheck check;
+        CheckState state;
+        bool fRecovered;
+        CKeyID keyID;
+    };
+
+    //! Mutex to protect the inner state
+    boost::mutex mutex;
+
+    //! Worker threads block on this when out of work
+    boost::condition_variable condWorker;
+
+    //! VerifyMessage blocks on this while a worker recovers its signature
+    boost::condition_variable condResult;
+
+    //! Checks waiting for a worker, in the order they were added
+    std::deque<uint256> queue;
+
+    //! Queued, running and finished checks by hash
+    std::map<uint256, CheckEntry> mapChecks;
+
+    //! All entries of mapChecks in the order they were added, to expire unused results
+    std::deque<uint256> dequeChecks;
+
+    //! The number of worker threads
+    int nWorkers;
+
+    //! The maximum number of checks taken by a worker at once
+    unsigned int nBatchSize;
+
+    unsigned int nMaxChecks;
+
+    /** Drop the oldest results nobody asked for */
+    void LimitSize();
+
+public:
+    CSignatureCheckQueue(unsigned int nBatchSizeIn, unsigned int nMaxChecksIn);
+
+    /** Worker thread */
+    void Thread();
+
+    /** True if at least one worker is running */
+    bool IsEnabled();
+
+    /** Queue signatures for recovery, ignored without workers */
+    void Add(std::vector<CSignatureCheck>& vChecks);
+
+    /**
+     * Get the result of a queued signature recovery and forget about it.
+     * Waits if a worker is busy with it, returns false if the signature was
+     * not queued or no worker picked it up yet.
+     */
+    bool GetResult(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, bool& fRecoveredRet, CKeyID& keyIDRet);
+};
+
+extern CSignatureCheckQueue sigcheckqueue;
+
+void ThreadSignatureCheck();
+
+/**
+ * Queue the signatures of the masternode, payment vote, lock vote and
+ * governance vote messages waiting in the receive buffer of a peer.
+ * Requires pfrom->cs_vRecvMsg.
+ */
+void QueueSignatureChecks(CNode* pfrom);
+
+#endif
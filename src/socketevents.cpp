@@ -0,0 +1,211 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "socketevents.h"
+
+#include "netbase.h"
+#include "util.h"
+#include "utiltime.h"
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+/** Maximum number of events taken from the kernel per wait, the rest is picked up by the next one */
+static const unsigned int MAX_EVENTS_PER_WAIT = 1024;
+
+CSocketEvents::CSocketEvents()
+{
+#ifdef USE_EPOLL
+    hEpoll = epoll_create1(EPOLL_CLOEXEC);
+    if (hEpoll == -1)
+        LogPrintf("%s: epoll_create1 failed, falling back to poll: %s\n", __func__, NetworkErrorString(errno));
+#endif
+}
+
+CSocketEvents::~CSocketEvents()
+{
+#ifdef USE_EPOLL
+    if (hEpoll != -1)
+        close(hEpoll);
+#endif
+}
+
+const char* CSocketEvents::GetMethodName() const
+{
+#ifdef USE_EPOLL
+    if (hEpoll != -1)
+        return "epoll";
+#endif
+#ifdef USE_POLL
+    return "poll";
+#else
+    return "select";
+#endif
+}
+
+bool CSocketEvents::Add(SOCKET hSocket, int64_t nId, bool fEdgeTriggered)
+{
+    if (hSocket == INVALID_SOCKET)
+        return false;
+
+#ifdef USE_EPOLL
+    if (hEpoll != -1) {
+        struct epoll_event event;
+        event.events = fEdgeTriggered ? (EPOLLIN | EPOLLOUT | EPOLLET) : EPOLLIN;
+        event.data.u64 = (uint64_t)nId;
+        if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+            // the previous owner of the socket number was closed without being removed
+            if (errno != EEXIST || epoll_ctl(hEpoll, EPOLL_CTL_MOD, hSocket, &event) != 0) {
+                LogPrintf("%s: epoll_ctl failed for socket %d: %s\n", __func__, hSocket, NetworkErrorString(errno));
+                return false;
+            }
+        }
+    }
+#endif
+
+    Entry& entry = mapEntries[nId];
+    entry.hSocket = hSocket;
+    entry.fEdgeTriggered = fEdgeTriggered;
+    entry.fArmedRecv = true;
+    entry.fArmedSend = true;
+    mapSocketIds[hSocket] = nId;
+    return true;
+}
+
+void CSocketEvents::Remove(int64_t nId)
+{
+    std::map<int64_t, Entry>::iterator it = mapEntries.find(nId);
+    if (it == mapEntries.end())
+        return;
+
+    // leave the socket alone if its number was taken over by a newer registration
+    std::map<SOCKET, int64_t>::iterator itId = mapSocketIds.find(it->second.hSocket);
+    if (itId != mapSocketIds.end() && itId->second == nId) {
+#ifdef USE_EPOLL
+        if (hEpoll != -1) {
+            // fails harmlessly if the socket was closed already
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            epoll_ctl(hEpoll, EPOLL_CTL_DEL, it->second.hSocket, &event);
+        }
+#endif
+        mapSocketIds.erase(itId);
+    }
+    mapEntries.erase(it);
+}
+
+void CSocketEvents::Rearm(int64_t nId, bool fRecv, bool fSend)
+{
+    std::map<int64_t, Entry>::iterator it = mapEntries.find(nId);
+    if (it == mapEntries.end())
+        return;
+    // epoll does this on its own
+    if (fRecv)
+        it->second.fArmedRecv = true;
+    if (fSend)
+        it->second.fArmedSend = true;
+}
+
+bool CSocketEvents::Wait(int64_t nTimeout, std::vector<CSocketEvent>& vEvents)
+{
+    vEvents.clear();
+
+#ifdef USE_EPOLL
+    if (hEpoll != -1) {
+        std::vector<struct epoll_event> vEpollEvents(std::max<size_t>(1, std::min<size_t>(mapEntries.size(), MAX_EVENTS_PER_WAIT)));
+        int nEvents = epoll_wait(hEpoll, &vEpollEvents[0], vEpollEvents.size(), nTimeout);
+        if (nEvents == -1)
+            return errno == EINTR;
+
+        vEvents.reserve(nEvents);
+        for (int i = 0; i < nEvents; i++) {
+            CSocketEvent event((int64_t)vEpollEvents[i].data.u64);
+            event.fRecv = vEpollEvents[i].events & (EPOLLIN | EPOLLPRI);
+            event.fSend = vEpollEvents[i].events & EPOLLOUT;
+            event.fError = vEpollEvents[i].events & (EPOLLERR | EPOLLHUP);
+            vEvents.push_back(event);
+        }
+        return true;
+    }
+#endif
+
+    // Only pass what the caller is waiting for, edge-triggered sockets are
+    // disarmed below once they are reported.
+    std::vector<std::map<int64_t, Entry>::iterator> vWaiting;
+    vWaiting.reserve(mapEntries.size());
+    for (std::map<int64_t, Entry>::iterator it = mapEntries.begin(); it != mapEntries.end(); ++it) {
+        if (!it->second.fEdgeTriggered || it->second.fArmedRecv || it->second.fArmedSend)
+            vWaiting.push_back(it);
+    }
+
+    if (vWaiting.empty()) {
+        MilliSleep(nTimeout);
+        return true;
+    }
+
+#ifdef USE_POLL
+    std::vector<struct pollfd> vPollFds(vWaiting.size());
+    for (size_t i = 0; i < vWaiting.size(); i++) {
+        const Entry& entry = vWaiting[i]->second;
+        vPollFds[i].fd = entry.hSocket;
+        vPollFds[i].events = 0;
+        if (!entry.fEdgeTriggered || entry.fArmedRecv)
+            vPollFds[i].events |= POLLIN;
+        if (entry.fEdgeTriggered && entry.fArmedSend)
+            vPollFds[i].events |= POLLOUT;
+        vPollFds[i].revents = 0;
+    }
+
+    if (poll(&vPollFds[0], vPollFds.size(), nTimeout) == SOCKET_ERROR)
+        return WSAGetLastError() == WSAEINTR;
+#else
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (size_t i = 0; i < vWaiting.size(); i++) {
+        const Entry& entry = vWaiting[i]->second;
+        FD_SET(entry.hSocket, &fdsetError);
+        if (!entry.fEdgeTriggered || entry.fArmedRecv)
+            FD_SET(entry.hSocket, &fdsetRecv);
+        if (entry.fEdgeTriggered && entry.fArmedSend)
+            FD_SET(entry.hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, entry.hSocket);
+    }
+
+    struct timeval timeout = MillisToTimeval(nTimeout);
+    if (select(hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout) == SOCKET_ERROR)
+        return false;
+#endif
+
+    for (size_t i = 0; i < vWaiting.size(); i++) {
+        Entry& entry = vWaiting[i]->second;
+        CSocketEvent event(vWaiting[i]->first);
+#ifdef USE_POLL
+        event.fRecv = vPollFds[i].revents & POLLIN;
+        event.fSend = vPollFds[i].revents & POLLOUT;
+        event.fError = vPollFds[i].revents & (POLLERR | POLLHUP | POLLNVAL);
+#else
+        event.fRecv = FD_ISSET(entry.hSocket, &fdsetRecv);
+        event.fSend = FD_ISSET(entry.hSocket, &fdsetSend);
+        event.fError = FD_ISSET(entry.hSocket, &fdsetError);
+#endif
+        if (!event.fRecv && !event.fSend && !event.fError)
+            continue;
+
+        if (entry.fEdgeTriggered) {
+            if (event.fRecv || event.fError)
+                entry.fArmedRecv = false;
+            if (event.fSend || event.fError)
+                entry.fArmedSend = false;
+        }
+        vEvents.push_back(event);
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SOCKETEVENTS_H
+#define SOCKETEVENTS_H
+
+#include "compat.h"
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+/** Readiness of a registered socket, as reported by CSocketEvents::Wait */
+struct CSocketEvent
+{
+    int64_t nId;
+    bool fRecv;
+    bool fSend;
+    bool fError;
+
+    CSocketEvent(int64_t nIdIn) : nId(nIdIn), fRecv(false), fSend(false), fError(false) {}
+};
+
+/**
+ * Waits until registered sockets become readable or writable.
+ *
+ * Edge-triggered sockets are reported once when they become ready and not
+ * again until the caller ran into WSAEWOULDBLOCK and re-armed them with
+ * Rearm(), so idle and throttled connections are not part of every wait.
+ * Level-triggered sockets, like the listening ones, are reported as long
+ * as they are readable.
+ *
+ * Uses epoll where available. Elsewhere, or if epoll can't be set up, the
+ * same behaviour is emulated on top of poll (select on Windows), which has
+ * to pass all armed sockets to the kernel on each wait.
+ *
+ * Not thread safe, meant to be owned by the socket handler thread.
+ */
+class CSocketEvents : private boost::noncopyable
+{
+private:
+    struct Entry {
+        SOCKET hSocket;
+        bool fEdgeTriggered;
+        bool fArmedRecv;
+        bool fArmedSend;
+    };
+
+    //! Registered sockets by id
+    std::map<int64_t, Entry> mapEntries;
+    //! Id which registered a socket last, a closed socket's number may be reused
+    std::map<SOCKET, int64_t> mapSocketIds;
+
+#ifdef USE_EPOLL
+    int hEpoll;
+#endif
+
+public:
+    CSocketEvents();
+    ~CSocketEvents();
+
+    /** Name of the mechanism in use, for logging */
+    const char* GetMethodName() const;
+
+    bool Add(SOCKET hSocket, int64_t nId, bool fEdgeTriggered);
+
+    /** Stop watching a socket, must be called before it is closed if possible */
+    void Remove(int64_t nId);
+
+    /** Report the socket again once it's readable (fRecv) or writable (fSend) */
+    void Rearm(int64_t nId, bool fRecv, bool fSend);
+
+    /** Wait up to nTimeout milliseconds for events, returns false on error */
+    bool Wait(int64_t nTimeout, std::vector<CSocketEvent>& vEvents);
+};
+
+#endif // SOCKETEVENTS_H
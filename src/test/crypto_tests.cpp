@@ -8,6 +8,7 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/neoscrypt.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_cerberus.h"
@@ -248,4 +249,33 @@ BOOST_AUTO_TEST_CASE(hmac_sha512_testvectors) {
                    "b6022cac3c4982b10d5eeb55c3e4de15134676fb6de0446065c97440fa8c6a58");
 }
 
+/* Results of the C implementation, which an --enable-neoscrypt-asm build has to reproduce */
+BOOST_AUTO_TEST_CASE(neoscrypt_testvectors) {
+    static const char *const vExpected[] = {
+        "4967121d009c05807811a33690da50a93722dedb440f58c1d600933ede9133c6",
+        "3bdb3239bd4b67fce242989e553c7d96755f8fa3768b2c39409f0feaccce1bda",
+        "0d839a4c3f161300f969be8345f1d57caa7291201a21ea593a122c54cbacb366",
+        "87846e2c77a98c320e8bc20eac0e962df489de7fbca82668ba08e69af4339c03",
+        "ed51219e0b63a2968e661d973d54aea261699dc913ba2e1d0b860893ef17233a",
+    };
+    const unsigned int nCount = sizeof(vExpected) / sizeof(vExpected[0]);
+
+    std::vector<unsigned char> vInput(nCount * 80);
+    for (unsigned int i = 0; i < vInput.size(); i++)
+        vInput[i] = (unsigned char)(i * 7 + 3);
+
+    // one at a time
+    for (unsigned int i = 0; i < nCount; i++) {
+        std::vector<unsigned char> vHash(32);
+        neoscrypt(&vInput[i * 80], &vHash[0], 0x0);
+        BOOST_CHECK_EQUAL(HexStr(vHash), vExpected[i]);
+    }
+
+    // 4 SIMD lanes (if available) and a remainder
+    std::vector<unsigned char> vHashes(nCount * 32);
+    neoscrypt_batch(&vInput[0], &vHashes[0], nCount);
+    for (unsigned int i = 0; i < nCount; i++)
+        BOOST_CHECK_EQUAL(HexStr(vHashes.begin() + i * 32, vHashes.begin() + (i + 1) * 32), vExpected[i]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
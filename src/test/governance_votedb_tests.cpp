@@ -0,0 +1,89 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-votedb.h"
+#include "streams.h"
+
+#include "test/test_cerberus.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votedb_tests, TestingSetup)
+
+static CGovernanceVote CreateVote(const uint256& nParentHash, int nMasternode, int64_t nTime)
+{
+    CGovernanceVote vote(CTxIn(COutPoint(uint256S("0x1234"), nMasternode)), nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    vote.SetTime(nTime);
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(governance_votedb_spill_reload)
+{
+    pgovernancevotedb = new CGovernanceVoteDB(1 << 20, true);
+    CGovernanceObjectVoteFile::SetMaxMemoryVotes(2);
+
+    const uint256 nParentHash = uint256S("0xabcd");
+    std::vector<CGovernanceVote> vecVotes;
+    CGovernanceObjectVoteFile fileVotes;
+    for(int i = 0; i < 5; ++i) {
+        vecVotes.push_back(CreateVote(nParentHash, i % 3, 1000 + i));
+        fileVotes.AddVote(vecVotes.back());
+    }
+
+    // all votes are found, whether they are still in memory or not
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 5);
+    BOOST_CHECK_EQUAL(fileVotes.GetVotes().size(), 5U);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteHashes().size(), 5U);
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        BOOST_CHECK(fileVotes.HasVote(vecVotes[i].GetHash()));
+        CGovernanceVote vote;
+        BOOST_CHECK(fileVotes.GetVote(vecVotes[i].GetHash(), vote));
+        BOOST_CHECK(vote.GetHash() == vecVotes[i].GetHash());
+    }
+    BOOST_CHECK(!fileVotes.HasVote(CreateVote(nParentHash, 7, 1000).GetHash()));
+
+    // reading the oldest vote back keeps it in memory, it is not listed twice
+    CGovernanceVote vote;
+    BOOST_CHECK(fileVotes.GetVote(vecVotes[0].GetHash(), vote));
+    BOOST_CHECK_EQUAL(fileVotes.GetVotes().size(), 5U);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteHashes().size(), 5U);
+
+    // only the votes in memory are serialized, the rest is found in the database
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << fileVotes;
+    CGovernanceObjectVoteFile fileVotesLoaded;
+    ss >> fileVotesLoaded;
+    BOOST_CHECK_EQUAL(fileVotesLoaded.GetVoteCount(), 5);
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        BOOST_CHECK(fileVotesLoaded.HasVote(vecVotes[i].GetHash()));
+    }
+
+    // votes held in memory but missing from the database, e.g. after a crash, are stored again
+    ss.clear();
+    ss << fileVotes;
+    pgovernancevotedb->EraseVote(vecVotes[0]);
+    BOOST_CHECK(!pgovernancevotedb->HasVote(nParentHash, vecVotes[0].GetHash()));
+    CGovernanceObjectVoteFile fileVotesRecovered;
+    ss >> fileVotesRecovered;
+    BOOST_CHECK(pgovernancevotedb->HasVote(nParentHash, vecVotes[0].GetHash()));
+    BOOST_CHECK_EQUAL(fileVotesRecovered.GetVoteHashes().size(), 5U);
+
+    // removing a masternode's votes finds them in memory and in the database
+    fileVotesRecovered.RemoveVotesFromMasternode(CTxIn(COutPoint(uint256S("0x1234"), 0)));
+    BOOST_CHECK_EQUAL(fileVotesRecovered.GetVoteCount(), 3);
+    BOOST_CHECK(!fileVotesRecovered.HasVote(vecVotes[0].GetHash()));
+    BOOST_CHECK(!fileVotesRecovered.HasVote(vecVotes[3].GetHash()));
+    BOOST_CHECK(fileVotesRecovered.HasVote(vecVotes[4].GetHash()));
+
+    fileVotesRecovered.RemoveDiskVotes();
+    std::vector<uint256> vecHashes;
+    BOOST_CHECK(pgovernancevotedb->ReadVoteHashes(nParentHash, vecHashes));
+    BOOST_CHECK(vecHashes.empty());
+
+    CGovernanceObjectVoteFile::SetMaxMemoryVotes(DEFAULT_GOVERNANCE_VOTE_CACHE);
+    delete pgovernancevotedb;
+    pgovernancevotedb = NULL;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
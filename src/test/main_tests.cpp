@@ -6,6 +6,8 @@
 
 #include "chainparams.h"
 #include "main.h"
+#include "pow.h"
+#include "consensus/validation.h"
 
 #include "test/test_cerberus.h"
 
@@ -79,4 +81,45 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_AUTO_TEST_CASE(check_headers_pow)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    // A continuous sequence of headers at the regtest PoW limit, spread over
+    // more than one check chunk
+    std::vector<CBlockHeader> headers(40);
+    uint256 hashPrev = consensusParams.hashGenesisBlock;
+    for (unsigned int i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 1;
+        headers[i].hashPrevBlock = hashPrev;
+        headers[i].nTime = 1417713337 + i;
+        headers[i].nBits = 0x207fffff;
+        while (!CheckProofOfWork(headers[i].GetHash(), headers[i].nBits, consensusParams))
+            headers[i].nNonce++;
+        hashPrev = headers[i].GetHash();
+    }
+    // start from scratch so the check does the hashing itself
+    for (unsigned int i = 0; i < headers.size(); i++)
+        headers[i].InvalidateHash();
+
+    std::vector<uint256> hashes;
+    CValidationState state;
+    BOOST_CHECK(CheckBlockHeadersPoW(headers, hashes, state));
+    BOOST_CHECK_EQUAL(hashes.size(), headers.size());
+    for (unsigned int i = 1; i < headers.size(); i++)
+        BOOST_CHECK(headers[i].hashPrevBlock == hashes[i - 1]);
+
+    // One header with an unmet target fails the whole message
+    headers[33].nBits = 0x1b06b2f1;
+    while (CheckProofOfWork(headers[33].GetHash(), headers[33].nBits, consensusParams))
+        headers[33].nNonce++;
+    int nDoS;
+    BOOST_CHECK(!CheckBlockHeadersPoW(headers, hashes, state));
+    BOOST_CHECK(state.IsInvalid(nDoS) && nDoS == 50);
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+
+    SelectParams(CBaseChainParams::MAIN);
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "consensus/validation.h"
+#include "main.h"
+#include "script/sign.h"
 #include "txmempool.h"
 #include "util.h"
 
@@ -317,6 +320,127 @@ BOOST_AUTO_TEST_CASE(MempoolIndexingTest)
     CheckSort<3>(pool, sortedOrder);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    entry.hadNoDependencies = true;
+
+    /* 3rd highest fee */
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), entry.Fee(10000LL).Priority(10.0).FromTx(tx1));
+
+    /* highest fee */
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx2.vout[0].nValue = 2 * COIN;
+    pool.addUnchecked(tx2.GetHash(), entry.Fee(20000LL).Priority(9.0).FromTx(tx2));
+    uint64_t tx2Size = ::GetSerializeSize(tx2, SER_NETWORK, PROTOCOL_VERSION);
+
+    /* lowest fee */
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx3.vout[0].nValue = 5 * COIN;
+    pool.addUnchecked(tx3.GetHash(), entry.Fee(0LL).Priority(100.0).FromTx(tx3));
+
+    /* 2nd highest fee */
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx4.vout[0].nValue = 6 * COIN;
+    pool.addUnchecked(tx4.GetHash(), entry.Fee(15000LL).Priority(1.0).FromTx(tx4));
+
+    /* equal fee rate to tx1, but newer */
+    CMutableTransaction tx5 = CMutableTransaction();
+    tx5.vout.resize(1);
+    tx5.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx5.vout[0].nValue = 11 * COIN;
+    pool.addUnchecked(tx5.GetHash(), entry.Fee(10000LL).FromTx(tx5));
+    BOOST_CHECK_EQUAL(pool.size(), 5);
+
+    std::vector<std::string> sortedOrder;
+    sortedOrder.resize(5);
+    sortedOrder[0] = tx2.GetHash().ToString(); // 20000
+    sortedOrder[1] = tx4.GetHash().ToString(); // 15000
+    // tx1 and tx5 are both 10000
+    // Ties are broken by hash, not timestamp, so determine which
+    // hash comes first.
+    if (tx1.GetHash() < tx5.GetHash()) {
+        sortedOrder[2] = tx1.GetHash().ToString();
+        sortedOrder[3] = tx5.GetHash().ToString();
+    } else {
+        sortedOrder[2] = tx5.GetHash().ToString();
+        sortedOrder[3] = tx1.GetHash().ToString();
+    }
+    sortedOrder[4] = tx3.GetHash().ToString(); // 0
+
+    CheckSort<4>(pool, sortedOrder);
+
+    /* low fee parent with high fee child */
+    /* tx6 (0) -> tx7 (high) */
+    CMutableTransaction tx6 = CMutableTransaction();
+    tx6.vout.resize(1);
+    tx6.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx6.vout[0].nValue = 20 * COIN;
+    uint64_t tx6Size = ::GetSerializeSize(tx6, SER_NETWORK, PROTOCOL_VERSION);
+
+    pool.addUnchecked(tx6.GetHash(), entry.Fee(0LL).FromTx(tx6));
+    BOOST_CHECK_EQUAL(pool.size(), 6);
+    // Ties are broken by hash
+    if (tx3.GetHash() < tx6.GetHash())
+        sortedOrder.push_back(tx6.GetHash().ToString());
+    else
+        sortedOrder.insert(sortedOrder.end()-1,tx6.GetHash().ToString());
+
+    CheckSort<4>(pool, sortedOrder);
+
+    CMutableTransaction tx7 = CMutableTransaction();
+    tx7.vin.resize(1);
+    tx7.vin[0].prevout = COutPoint(tx6.GetHash(), 0);
+    tx7.vin[0].scriptSig = CScript() << OP_11;
+    tx7.vout.resize(1);
+    tx7.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx7.vout[0].nValue = 10 * COIN;
+    uint64_t tx7Size = ::GetSerializeSize(tx7, SER_NETWORK, PROTOCOL_VERSION);
+
+    /* set the fee to just below tx2's feerate when including ancestor */
+    CAmount fee = (20000/tx2Size)*(tx7Size + tx6Size) - 1;
+
+    pool.addUnchecked(tx7.GetHash(), entry.Fee(fee).FromTx(tx7));
+    BOOST_CHECK_EQUAL(pool.size(), 7);
+    sortedOrder.insert(sortedOrder.begin()+1, tx7.GetHash().ToString());
+    CheckSort<4>(pool, sortedOrder);
+
+    CTxMemPool::txiter it7 = pool.mapTx.find(tx7.GetHash());
+    BOOST_CHECK_EQUAL(it7->GetCountWithAncestors(), 2);
+    BOOST_CHECK_EQUAL(it7->GetSizeWithAncestors(), tx6Size + tx7Size);
+    BOOST_CHECK_EQUAL(it7->GetModFeesWithAncestors(), fee);
+
+    /* after tx6 is mined, tx7 should move up in the sort */
+    std::vector<CTransaction> vtx;
+    vtx.push_back(tx6);
+    std::list<CTransaction> dummy;
+    pool.removeForBlock(vtx, 1, dummy, false);
+
+    sortedOrder.erase(sortedOrder.begin()+1);
+    // Ties are broken by hash
+    if (tx3.GetHash() < tx6.GetHash())
+        sortedOrder.pop_back();
+    else
+        sortedOrder.erase(sortedOrder.end()-2);
+    sortedOrder.insert(sortedOrder.begin(), tx7.GetHash().ToString());
+    CheckSort<4>(pool, sortedOrder);
+
+    it7 = pool.mapTx.find(tx7.GetHash());
+    BOOST_CHECK_EQUAL(it7->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(it7->GetSizeWithAncestors(), tx7Size);
+}
+
 
 BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
 {
@@ -473,4 +597,63 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_FIXTURE_TEST_CASE(MempoolPersistTest, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = coinbaseTxns[0].GetHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 11*CENT;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+    std::vector<unsigned char> vchSig;
+    uint256 hashSig = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL);
+    BOOST_CHECK(coinbaseKey.Sign(hashSig, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    uint256 hashTx = tx.GetHash();
+
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, tx, false, NULL));
+    }
+    mempool.PrioritiseTransaction(hashTx, hashTx.ToString(), 1000.0, 1000);
+
+    // dump and load back into an empty mempool
+    BOOST_CHECK(DumpMempool());
+    mempool.clear();
+    mempool.ClearPrioritisation(hashTx);
+    BOOST_CHECK(!mempool.exists(hashTx));
+
+    BOOST_CHECK(LoadMempool());
+    BOOST_CHECK(mempool.exists(hashTx));
+    double dPriorityDelta = 0;
+    CAmount nFeeDelta = 0;
+    mempool.ApplyDeltas(hashTx, dPriorityDelta, nFeeDelta);
+    BOOST_CHECK_EQUAL(dPriorityDelta, 1000.0);
+    BOOST_CHECK_EQUAL(nFeeDelta, 1000);
+
+    // a corrupted file is rejected before anything is added
+    boost::filesystem::path path = GetDataDir() / "mempool.dat";
+    std::vector<char> vchFile(boost::filesystem::file_size(path));
+    {
+        FILE* file = fopen(path.string().c_str(), "rb");
+        BOOST_CHECK(fread(&vchFile[0], 1, vchFile.size(), file) == vchFile.size());
+        fclose(file);
+    }
+    vchFile[vchFile.size() / 2] ^= 1;
+    {
+        FILE* file = fopen(path.string().c_str(), "wb");
+        BOOST_CHECK(fwrite(&vchFile[0], 1, vchFile.size(), file) == vchFile.size());
+        fclose(file);
+    }
+    mempool.clear();
+    mempool.ClearPrioritisation(hashTx);
+    BOOST_CHECK(!LoadMempool());
+    BOOST_CHECK(!mempool.exists(hashTx));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
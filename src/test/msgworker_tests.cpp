@@ -0,0 +1,101 @@
+// Copyright (c) 2017-2018 The Cerberus Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "main.h"
+#include "net.h"
+#include "utiltime.h"
+
+#include "test/test_cerberus.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(msgworker_tests, TestingSetup)
+
+static CAddress TestAddress(const char* pszIP)
+{
+    return CAddress(CService(CNetAddr(pszIP), Params().GetDefaultPort()));
+}
+
+static void ReceiveMessage(CNode& node, const char* pszCommand, const CDataStream& ssPayload)
+{
+    CMessageHeader hdr(Params().MessageStart(), pszCommand, ssPayload.size());
+    uint256 hash = Hash(ssPayload.begin(), ssPayload.end());
+    hdr.nChecksum = ReadLE32(hash.begin());
+
+    CDataStream ssMessage(SER_NETWORK, PROTOCOL_VERSION);
+    ssMessage << hdr;
+    ssMessage += ssPayload;
+
+    LOCK(node.cs_vRecvMsg);
+    BOOST_CHECK(node.ReceiveMsgBytes(&ssMessage[0], ssMessage.size()));
+}
+
+BOOST_AUTO_TEST_CASE(msgworker_dispatch)
+{
+    CAddress addr = TestAddress("10.0.0.1");
+    CNode dummyNode(INVALID_SOCKET, addr, "", true);
+    dummyNode.nVersion = PROTOCOL_VERSION;
+    dummyNode.fSuccessfullyConnected = true;
+
+    boost::thread_group workerGroup;
+    StartMessageWorkers(workerGroup, 1);
+
+    // two masternode messages followed by a ping
+    for (int i = 0; i < 2; i++) {
+        CDataStream ssPayload(SER_NETWORK, PROTOCOL_VERSION);
+        ssPayload << i << 0;
+        ReceiveMessage(dummyNode, NetMsgType::SYNCSTATUSCOUNT, ssPayload);
+    }
+    CDataStream ssPing(SER_NETWORK, PROTOCOL_VERSION);
+    ssPing << (uint64_t)1;
+    ReceiveMessage(dummyNode, NetMsgType::PING, ssPing);
+
+    // the message handler hands the peer over at the first masternode message
+    {
+        LOCK(dummyNode.cs_vRecvMsg);
+        BOOST_CHECK(ProcessMessages(&dummyNode));
+        BOOST_CHECK(dummyNode.fOnMessageWorker);
+        BOOST_CHECK_EQUAL(dummyNode.vRecvMsg.size(), 3U);
+    }
+
+    for (int i = 0; i < 500 && dummyNode.fOnMessageWorker; i++)
+        MilliSleep(10);
+    BOOST_CHECK(!dummyNode.fOnMessageWorker);
+
+    // the worker processed both masternode messages and handed the peer back at the ping
+    {
+        LOCK(dummyNode.cs_vRecvMsg);
+        BOOST_CHECK(!dummyNode.fDisconnect);
+        BOOST_CHECK_EQUAL(dummyNode.vRecvMsg.size(), 1U);
+        BOOST_CHECK_EQUAL(dummyNode.vRecvMsg.front().hdr.GetCommand(), NetMsgType::PING);
+
+        BOOST_CHECK(ProcessMessages(&dummyNode));
+        BOOST_CHECK(!dummyNode.fOnMessageWorker);
+        BOOST_CHECK(dummyNode.vRecvMsg.empty());
+    }
+
+    workerGroup.interrupt_all();
+    workerGroup.join_all();
+    StartMessageWorkers(workerGroup, 0);
+}
+
+BOOST_AUTO_TEST_CASE(msgworker_misbehaving)
+{
+    CAddress addr = TestAddress("10.0.0.2");
+    CNode dummyNode(INVALID_SOCKET, addr, "", true);
+    dummyNode.nVersion = 1;
+
+    // outside of the message workers the score is applied right away
+    BOOST_CHECK(!IsMessageWorkerThread());
+    Misbehaving(dummyNode.GetId(), 10);
+    CNodeStateStats stats;
+    BOOST_CHECK(GetNodeStateStats(dummyNode.GetId(), stats));
+    BOOST_CHECK_EQUAL(stats.nMisbehavior, 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #include "chain.h"
 #include "chainparams.h"
 #include "pow.h"
+#include "primitives/block.h"
 #include "random.h"
 #include "util.h"
 #include "test/test_cerberus.h"
@@ -96,4 +97,71 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/* The memoized header hash must follow any mutation of the header fields */
+BOOST_AUTO_TEST_CASE(header_hash_memoization)
+{
+    CBlockHeader header;
+    header.nVersion = 1;
+    header.nTime = 1408732505;
+    header.nBits = 0x1b06b2f1;
+    header.nNonce = 42;
+
+    uint256 hash = header.GetHash();
+    BOOST_CHECK_EQUAL(header.GetHashEvaluations(), 1U);
+    BOOST_CHECK(header.GetHash() == hash);
+    BOOST_CHECK_EQUAL(header.GetHashEvaluations(), 1U);
+
+    // copies carry the cached hash along
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(block.GetBlockHeader().GetHash() == hash);
+    BOOST_CHECK_EQUAL(block.GetHashEvaluations(), 1U);
+
+    // mutating a field invalidates the cache
+    header.nNonce++;
+    uint256 hash2 = header.GetHash();
+    BOOST_CHECK(hash2 != hash);
+    BOOST_CHECK_EQUAL(header.GetHashEvaluations(), 2U);
+    header.nNonce--;
+    BOOST_CHECK(header.GetHash() == hash);
+    BOOST_CHECK_EQUAL(header.GetHashEvaluations(), 3U);
+
+    // a fresh header with the same fields hashes identically
+    CBlockHeader header2;
+    header2.nVersion = header.nVersion;
+    header2.nTime = header.nTime;
+    header2.nBits = header.nBits;
+    header2.nNonce = header.nNonce;
+    BOOST_CHECK(header2.GetHash() == hash);
+}
+
+/* Batch hashing must agree with hashing the headers one by one */
+BOOST_AUTO_TEST_CASE(header_hash_batch)
+{
+    // 7 headers cover both the SIMD lanes and the scalar remainder
+    std::vector<CBlockHeader> headers(7);
+    for (unsigned int i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 1;
+        headers[i].nTime = 1408732505 + i;
+        headers[i].nBits = 0x1b06b2f1;
+        headers[i].nNonce = i * 1000;
+    }
+    uint256 hashPrecomputed = headers[2].GetHash();
+
+    std::vector<uint256> hashes;
+    GetBlockHeaderHashes(headers, hashes);
+    BOOST_CHECK_EQUAL(hashes.size(), headers.size());
+    BOOST_CHECK(hashes[2] == hashPrecomputed);
+    for (unsigned int i = 0; i < headers.size(); i++) {
+        BOOST_CHECK(headers[i].IsHashCached());
+        BOOST_CHECK_EQUAL(headers[i].GetHashEvaluations(), 1U);
+        CBlockHeader copy;
+        copy.nVersion = headers[i].nVersion;
+        copy.nTime = headers[i].nTime;
+        copy.nBits = headers[i].nBits;
+        copy.nNonce = headers[i].nNonce;
+        BOOST_CHECK(copy.GetHash() == hashes[i]);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -70,8 +70,10 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         RegisterValidationInterface(pwalletMain);
 #endif
         nScriptCheckThreads = 3;
-        for (int i=0; i < nScriptCheckThreads-1; i++)
+        for (int i=0; i < nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadHeaderCheck);
+        }
         RegisterNodeSignals(GetNodeSignals());
 }
 
@@ -23,6 +23,7 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCEINDEX = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
@@ -196,16 +197,23 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CAddressUnspentKey *pFrom, size_t nLimit) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pFrom) {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, *pFrom));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
-    while (pcursor->Valid()) {
+    size_t nCount = 0;
+    while (pcursor->Valid() && (nLimit == 0 || nCount < nLimit)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            nCount++;
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
                 unspentOutputs.push_back(make_pair(key.second, nValue));
@@ -237,23 +245,28 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end,
+                                    const CAddressIndexKey *pFrom, size_t nLimit) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pFrom) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pFrom));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
-    while (pcursor->Valid()) {
+    size_t nCount = 0;
+    while (pcursor->Valid() && (nLimit == 0 || nCount < nLimit)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
+            nCount++;
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
                 addressIndex.push_back(make_pair(key.second, nValue));
@@ -269,6 +282,169 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+namespace {
+/** Change of an address' totals within one block */
+struct CAddressBalanceDelta {
+    CAmount balance;
+    CAmount received;
+    unsigned int txCount;
+    uint256 lastTxHash;
+
+    CAddressBalanceDelta() : balance(0), received(0), txCount(0) {}
+
+    void Add(const CAddressIndexKey &key, CAmount nValue) {
+        balance += nValue;
+        if (nValue > 0)
+            received += nValue;
+        // entries of the same transaction are next to each other
+        if (txCount == 0 || key.txhash != lastTxHash) {
+            txCount++;
+            lastTxHash = key.txhash;
+        }
+    }
+};
+}
+
+bool CBlockTreeDB::UpdateAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect,
+                                             const CBlockIndex *pindex, bool fDisconnect) {
+    std::map<std::pair<unsigned int, uint160>, CAddressBalanceDelta> mapDeltas;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        mapDeltas[make_pair(it->first.type, it->first.hashBytes)].Add(it->first, it->second);
+
+    CDBBatch batch(&GetObfuscateKey());
+    for (std::map<std::pair<unsigned int, uint160>, CAddressBalanceDelta>::const_iterator it=mapDeltas.begin(); it!=mapDeltas.end(); it++) {
+        const CAddressIndexIteratorKey key(it->first.first, it->first.second);
+        const CAddressBalanceDelta &delta = it->second;
+        CAddressBalanceValue value;
+        if (!Read(make_pair(DB_ADDRESSBALANCEINDEX, key), value))
+            value.SetNull();
+
+        // The block tree can be ahead of the chainstate after an unclean
+        // shutdown, and -checklevel=4 connects blocks again without having
+        // disconnected them here. So look at where the totals are up to:
+        // if that is this block or one after it, the block is included.
+        const CBlockIndex *pindexValue = NULL;
+        bool fKnown = value.hashBlock.IsNull();
+        if (!fKnown) {
+            BlockMap::const_iterator mi = mapBlockIndex.find(value.hashBlock);
+            if (mi != mapBlockIndex.end() && mi->second->nHeight == value.nHeight) {
+                pindexValue = mi->second;
+                fKnown = true;
+            }
+        }
+        bool fIncluded = pindexValue && pindexValue->GetAncestor(pindex->nHeight) == pindex;
+        bool fBefore = !pindexValue || (pindexValue != pindex && pindex->GetAncestor(pindexValue->nHeight) == pindexValue);
+
+        if (!fKnown || (!fIncluded && !fBefore)) {
+            // the totals are from another branch, which was never disconnected
+            if (!RebuildAddressBalance(key, pindex->nHeight - 1, value))
+                return false;
+            fIncluded = false;
+        } else if (fDisconnect && !fIncluded) {
+            continue;
+        }
+
+        if (fDisconnect) {
+            if (fIncluded) {
+                value.balance -= delta.balance;
+                value.received -= delta.received;
+                value.txCount -= delta.txCount;
+            }
+            value.nHeight = pindex->nHeight - 1;
+            value.hashBlock = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+        } else {
+            if (fIncluded)
+                continue;
+            value.balance += delta.balance;
+            value.received += delta.received;
+            value.txCount += delta.txCount;
+            value.nHeight = pindex->nHeight;
+            value.hashBlock = pindex->GetBlockHash();
+        }
+        batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, key), value);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::RebuildAddressBalance(const CAddressIndexIteratorKey &key, int nMaxHeight, CAddressBalanceValue &value) {
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!ReadAddressIndex(key.hashBytes, key.type, addressIndex))
+        return error("failed to rebuild address balance");
+
+    CAddressBalanceDelta delta;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
+        if (it->first.blockHeight <= nMaxHeight)
+            delta.Add(it->first, it->second);
+
+    value.balance = delta.balance;
+    value.received = delta.received;
+    value.txCount = delta.txCount;
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalanceIndex(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    // like an empty address index, an address that was never seen has zero totals
+    if (!Read(make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), value))
+        value.SetNull();
+    return true;
+}
+
+static bool WriteAddressBalances(CBlockTreeDB &db, std::vector<std::pair<CAddressIndexIteratorKey, CAddressBalanceValue> > &vect) {
+    CDBBatch batch(&db.GetObfuscateKey());
+    for (std::vector<std::pair<CAddressIndexIteratorKey, CAddressBalanceValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, it->first), it->second);
+    vect.clear();
+    return db.WriteBatch(batch);
+}
+
+bool CBlockTreeDB::BuildAddressBalanceIndex(int nMaxHeight, const uint256 &hashMaxBlock) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(DB_ADDRESSINDEX);
+
+    std::vector<std::pair<CAddressIndexIteratorKey, CAddressBalanceValue> > vBalances;
+    CAddressBalanceDelta delta;
+    CAddressIndexIteratorKey addressKey;
+    size_t nAddresses = 0;
+
+    while (true) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX;
+        if (delta.txCount > 0 && (!fValid || key.second.type != addressKey.type || key.second.hashBytes != addressKey.hashBytes)) {
+            CAddressBalanceValue value;
+            value.balance = delta.balance;
+            value.received = delta.received;
+            value.txCount = delta.txCount;
+            value.nHeight = nMaxHeight;
+            value.hashBlock = hashMaxBlock;
+            vBalances.push_back(make_pair(addressKey, value));
+            delta = CAddressBalanceDelta();
+            nAddresses++;
+            if (vBalances.size() >= 10000 && !WriteAddressBalances(*this, vBalances))
+                return false;
+        }
+        if (!fValid)
+            break;
+
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+        // blocks above the tip get connected again
+        if (key.second.blockHeight <= nMaxHeight) {
+            addressKey = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+            delta.Add(key.second, nValue);
+        }
+        pcursor->Next();
+    }
+
+    if (!WriteAddressBalances(*this, vBalances))
+        return false;
+
+    LogPrintf("%s: indexed the balances of %u addresses\n", __func__, nAddresses);
+    return true;
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(&GetObfuscateKey());
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
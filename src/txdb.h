@@ -22,6 +22,7 @@ struct CAddressUnspentValue;
 struct CAddressIndexKey;
 struct CAddressIndexIteratorKey;
 struct CAddressIndexIteratorHeightKey;
+struct CAddressBalanceValue;
 struct CTimestampIndexKey;
 struct CTimestampIndexIteratorKey;
 struct CSpentIndexKey;
@@ -69,13 +70,22 @@ public:
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
+    /** Read the unspent outputs of an address in key order, starting at *pFrom and stopping after nLimit if given */
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CAddressUnspentKey *pFrom = NULL, size_t nLimit = 0);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    /** Read the history of an address in height order, starting at *pFrom and stopping after nLimit if given */
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0,
+                          const CAddressIndexKey *pFrom = NULL, size_t nLimit = 0);
+    bool UpdateAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect,
+                                   const CBlockIndex *pindex, bool fDisconnect);
+    bool ReadAddressBalanceIndex(uint160 addressHash, int type, CAddressBalanceValue &value);
+    bool RebuildAddressBalance(const CAddressIndexIteratorKey &key, int nMaxHeight, CAddressBalanceValue &value);
+    bool BuildAddressBalanceIndex(int nMaxHeight, const uint256 &hashMaxBlock);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
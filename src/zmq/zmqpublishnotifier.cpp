@@ -176,18 +176,17 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CDiskBlockPos pos;
     {
         LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
+        pos = pindex->GetBlockPos();
+    }
 
-        ss << block;
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    if(!ReadRawBlockFromDisk(ss, pos, Params().MessageStart()))
+    {
+        zmqError("Can't read block from disk");
+        return false;
     }
 
     return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());